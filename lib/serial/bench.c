@@ -0,0 +1,187 @@
+/*===--------------------------------------------------------------------------------------------===
+ * bench.c
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent. All rights reserved
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+// Compares the serial backends on pty-backed fake boards. Each "frame" does what the plugin's
+// flight loop does: read every port, then write one output frame to every port. A quarter of the
+// boards send an input event each frame; the rest are idle.
+//
+//  usage: serial_bench [devices] [frames]
+#define _GNU_SOURCE
+#include "serial_impl.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MSG_LEN     (12)
+
+typedef struct {
+    int         master;
+    serial_t    *serial;
+    char        partial[MSG_LEN];
+    int         partial_len;
+} board_t;
+
+typedef enum {
+    BACKEND_POSIX,
+    BACKEND_REACTOR,
+    BACKEND_URING,
+} backend_t;
+
+static const char *backend_names[] = {
+    [BACKEND_POSIX]     = "posix",
+    [BACKEND_REACTOR]   = "epoll",
+    [BACKEND_URING]     = "io_uring",
+};
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static bool open_board(board_t *board) {
+    memset(board, 0, sizeof(*board));
+    board->master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if(board->master < 0 || grantpt(board->master) < 0 || unlockpt(board->master) < 0)
+        return false;
+    board->serial = serial_open(ptsname(board->master), SERIAL_BAUDS_115200);
+    return board->serial != NULL;
+}
+
+static void close_board(board_t *board) {
+    if(board->serial)
+        serial_close(board->serial);
+    if(board->master >= 0)
+        close(board->master);
+}
+
+// Returns the total frame lag of the events found in `buf`.
+static long consume(board_t *board, const char *buf, int len, int frame, int *count) {
+    long lag = 0;
+    for(int i = 0; i < len; ++i) {
+        board->partial[board->partial_len++] = buf[i];
+        if(board->partial_len < MSG_LEN)
+            continue;
+        board->partial_len = 0;
+        lag += frame - atoi(board->partial + 2);
+        *count += 1;
+    }
+    return lag;
+}
+
+static void run(backend_t backend, board_t *boards, int count, int frames) {
+    serial_reactor_t *reactor = NULL;
+    serial_uring_t *ring = NULL;
+    
+    if(backend == BACKEND_REACTOR) {
+        reactor = serial_reactor_new();
+        if(reactor == NULL) {
+            printf("%-10s unavailable\n", backend_names[backend]);
+            return;
+        }
+        for(int i = 0; i < count; ++i)
+            serial_reactor_add(reactor, boards[i].serial);
+    } else if(backend == BACKEND_URING) {
+        ring = serial_uring_new(count);
+        if(ring == NULL) {
+            printf("%-10s unavailable\n", backend_names[backend]);
+            return;
+        }
+        for(int i = 0; i < count; ++i)
+            serial_uring_add(ring, boards[i].serial);
+    }
+    
+    double frame_time = 0, worst = 0;
+    unsigned long syscalls = 0;
+    long lag = 0;
+    int events = 0;
+    
+    for(int frame = 0; frame < frames; ++frame) {
+        char buf[512];
+        
+        // Board side, not measured.
+        for(int i = 0; i < count; ++i) {
+            if((frame + i) % 4 != 0)
+                continue;
+            char msg[32];
+            snprintf(msg, sizeof(msg), "7,%06d;\r\n", frame % 1000000);
+            ssize_t rc = write(boards[i].master, msg, MSG_LEN);
+            (void)rc;
+        }
+        usleep(1000);
+        
+        // Plugin side.
+        unsigned long calls = atomic_load(&serial_syscall_count);
+        double start = now_us();
+        for(int i = 0; i < count; ++i) {
+            int len;
+            while((len = serial_read(boards[i].serial, buf, sizeof(buf))) > 0)
+                lag += consume(&boards[i], buf, len, frame, &events);
+            
+            int out = snprintf(buf, sizeof(buf), "2,8,%d;\r\n", frame % 255);
+            serial_write(boards[i].serial, buf, out);
+        }
+        if(ring != NULL)
+            serial_uring_flush(ring);
+        double elapsed = now_us() - start;
+        syscalls += atomic_load(&serial_syscall_count) - calls;
+        frame_time += elapsed;
+        if(elapsed > worst)
+            worst = elapsed;
+        
+        for(int i = 0; i < count; ++i) {
+            while(read(boards[i].master, buf, sizeof(buf)) > 0) {}
+        }
+    }
+    
+    printf("%-10s %8.1f us/frame (worst %7.1f)  %7.1f syscalls/frame  %5.2f frames input lag"
+           "  (%d events)\n",
+           backend_names[backend], frame_time / frames, worst, (double)syscalls / frames,
+           events ? (double)lag / events : 0.0, events);
+    
+    for(int i = 0; i < count; ++i) {
+        if(reactor)
+            serial_reactor_remove(reactor, boards[i].serial);
+        if(ring)
+            serial_uring_remove(ring, boards[i].serial);
+        boards[i].partial_len = 0;
+    }
+    serial_reactor_destroy(reactor);
+    serial_uring_destroy(ring);
+}
+
+int main(int argc, const char **argv) {
+    int count = argc > 1 ? atoi(argv[1]) : 16;
+    int frames = argc > 2 ? atoi(argv[2]) : 2000;
+    if(count <= 0 || frames <= 0) {
+        fprintf(stderr, "usage: %s [devices] [frames]\n", argv[0]);
+        return -1;
+    }
+    
+    board_t *boards = calloc(count, sizeof(*boards));
+    for(int i = 0; i < count; ++i) {
+        if(!open_board(&boards[i])) {
+            fprintf(stderr, "unable to open pty #%d\n", i);
+            return -1;
+        }
+    }
+    
+    printf("%d devices, %d frames\n", count, frames);
+    run(BACKEND_POSIX, boards, count, frames);
+    run(BACKEND_REACTOR, boards, count, frames);
+    run(BACKEND_URING, boards, count, frames);
+    
+    for(int i = 0; i < count; ++i)
+        close_board(&boards[i]);
+    free(boards);
+    return 0;
+}
@@ -0,0 +1,316 @@
+/*===--------------------------------------------------------------------------------------------===
+ * capture.c
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent. All rights reserved
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#include "serial_impl.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if USE_POSIX
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+// Capture files are a 12-byte header followed by one record per chunk. All integers are little
+// endian.
+//
+//  header: "AVCP", u8 version, u8[3] reserved, u32 baud rate
+//  record: u32 microseconds since the previous record, u8 direction (0 = rx, 1 = tx), u16 length,
+//          then `length` bytes of data
+#define CAPTURE_MAGIC       "AVCP"
+#define CAPTURE_VERSION     (1)
+#define CAPTURE_HEADER_SIZE (12)
+#define RECORD_HEADER_SIZE  (7)
+#define RECORD_MAX_DATA     (0xffff)
+
+struct serial_capture_t {
+    FILE            *out;
+    uint64_t        last_time;
+    pthread_mutex_t lock;
+};
+
+typedef struct {
+    uint8_t     *data;
+    size_t      size;
+    size_t      off;            // Start of the next record
+    size_t      chunk_off;      // How much of the current rx record has already been read
+    bool        timed;          // Whether `cap_time` includes the current record yet
+    double      speed;          // Playback speed multiplier, 0 for "as fast as it's read"
+    uint64_t    start;          // When playback started
+    uint64_t    cap_time;       // Capture time of the next record
+} replay_t;
+
+static void put_u16(uint8_t *out, uint16_t val) {
+    out[0] = val & 0xff;
+    out[1] = (val >> 8) & 0xff;
+}
+
+static void put_u32(uint8_t *out, uint32_t val) {
+    put_u16(out, val & 0xffff);
+    put_u16(out + 2, val >> 16);
+}
+
+static uint16_t get_u16(const uint8_t *in) {
+    return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *in) {
+    return get_u16(in) | ((uint32_t)get_u16(in + 2) << 16);
+}
+
+// MARK: - Capture
+
+bool serial_capture_start(serial_t *serial, const char *path) {
+    serial_capture_stop(serial);
+
+    struct serial_capture_t *capture = calloc(1, sizeof(*capture));
+    if(capture == NULL)
+        return false;
+    capture->out = fopen(path, "wb");
+    if(capture->out == NULL) {
+        fprintf(stderr, "error: cannot open capture `%s`: %s\n", path, strerror(errno));
+        free(capture);
+        return false;
+    }
+
+    uint8_t header[CAPTURE_HEADER_SIZE] = {};
+    memcpy(header, CAPTURE_MAGIC, 4);
+    header[4] = CAPTURE_VERSION;
+    put_u32(header + 8, serial->baud_rate);
+    fwrite(header, sizeof(header), 1, capture->out);
+
+    pthread_mutex_init(&capture->lock, NULL);
+    capture->last_time = serial_now_us();
+    serial->capture = capture;
+    return true;
+}
+
+void serial_capture_stop(serial_t *serial) {
+    struct serial_capture_t *capture = serial->capture;
+    if(capture == NULL)
+        return;
+    serial->capture = NULL;
+    fclose(capture->out);
+    pthread_mutex_destroy(&capture->lock);
+    free(capture);
+}
+
+void serial_capture_record(serial_t *serial, int dir, const char *data, int len) {
+    struct serial_capture_t *capture = serial->capture;
+
+    // The I/O thread and the flight loop can both touch a port, keep records in one piece.
+    pthread_mutex_lock(&capture->lock);
+    while(len > 0) {
+        int chunk = len > RECORD_MAX_DATA ? RECORD_MAX_DATA : len;
+        uint64_t now = serial_now_us();
+        uint64_t delta = now - capture->last_time;
+        capture->last_time = now;
+
+        uint8_t header[RECORD_HEADER_SIZE];
+        put_u32(header, delta > UINT32_MAX ? UINT32_MAX : (uint32_t)delta);
+        header[4] = (uint8_t)dir;
+        put_u16(header + 5, (uint16_t)chunk);
+        fwrite(header, sizeof(header), 1, capture->out);
+        fwrite(data, chunk, 1, capture->out);
+
+        data += chunk;
+        len -= chunk;
+    }
+    pthread_mutex_unlock(&capture->lock);
+}
+
+// MARK: - Replay
+
+// Skips sent data, which only moves the clock forward. Returns false at the end of the capture.
+static bool replay_seek_rx(replay_t *replay) {
+    while(replay->off + RECORD_HEADER_SIZE <= replay->size) {
+        const uint8_t *rec = replay->data + replay->off;
+        uint16_t len = get_u16(rec + 5);
+        if(replay->off + RECORD_HEADER_SIZE + len > replay->size)
+            return false;
+        if(!replay->timed) {
+            replay->cap_time += get_u32(rec);
+            replay->timed = true;
+        }
+        if(rec[4] == CAPTURE_RX && replay->chunk_off < len)
+            return true;
+        replay->off += RECORD_HEADER_SIZE + len;
+        replay->chunk_off = 0;
+        replay->timed = false;
+    }
+    return false;
+}
+
+// How long until the next received chunk is due, in microseconds.
+static int64_t replay_wait_time(replay_t *replay) {
+    if(replay->speed <= 0)
+        return 0;
+    uint64_t due = replay->start + (uint64_t)(replay->cap_time / replay->speed);
+    uint64_t now = serial_now_us();
+    return due > now ? (int64_t)(due - now) : 0;
+}
+
+// The end of a capture is a board that has gone quiet, not one that was unplugged: reporting it as
+// a lost link would only get the replay reopened and played again.
+static int replay_read(serial_t *serial, char *buffer, int cap) {
+    replay_t *replay = serial->backend_data;
+    if(!replay_seek_rx(replay))
+        return 0;
+    if(replay_wait_time(replay) > 0)
+        return 0;
+
+    // Chunks come back exactly as they were captured (or split to fit the buffer), so replaying the
+    // same capture always produces the same sequence of reads.
+    const uint8_t *rec = replay->data + replay->off;
+    int len = get_u16(rec + 5) - (int)replay->chunk_off;
+    if(len > cap)
+        len = cap;
+    memcpy(buffer, rec + RECORD_HEADER_SIZE + replay->chunk_off, len);
+    replay->chunk_off += len;
+    serial->rx_time = serial_now_us();
+    if(replay->chunk_off == get_u16(rec + 5)) {
+        replay->off += RECORD_HEADER_SIZE + replay->chunk_off;
+        replay->chunk_off = 0;
+        replay->timed = false;
+    }
+    return len;
+}
+
+static int replay_write(serial_t *serial, const char *buffer, int num) {
+    (void)serial;
+    (void)buffer;
+    return num;
+}
+
+static int replay_poll(serial_t *serial, int timeout_ms) {
+    replay_t *replay = serial->backend_data;
+    int64_t wait = replay_seek_rx(replay) ? replay_wait_time(replay) : INT64_MAX;
+    if(wait > (int64_t)timeout_ms * 1000) {
+        struct timespec ts = {.tv_sec = timeout_ms / 1000, .tv_nsec = (timeout_ms % 1000) * 1000000L};
+        nanosleep(&ts, NULL);
+        return 0;
+    }
+    if(wait > 0) {
+        struct timespec ts = {.tv_sec = wait / 1000000, .tv_nsec = (wait % 1000000) * 1000};
+        nanosleep(&ts, NULL);
+    }
+    return 1;
+}
+
+static void replay_detach(serial_t *serial) {
+    replay_t *replay = serial->backend_data;
+    free(replay->data);
+    free(replay);
+    serial->backend = NULL;
+    serial->backend_data = NULL;
+}
+
+static const serial_backend_t replay_backend = {
+    .read = replay_read,
+    .write = replay_write,
+    .poll = replay_poll,
+    .detach = replay_detach,
+};
+
+serial_t *serial_open_replay(const char *path, float speed) {
+    FILE *in = fopen(path, "rb");
+    if(in == NULL) {
+        fprintf(stderr, "error: cannot open capture `%s`: %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    // Captures are loaded whole so playback never waits on the disk.
+    replay_t *replay = calloc(1, sizeof(*replay));
+    serial_t *serial = calloc(1, sizeof(*serial));
+    uint8_t header[CAPTURE_HEADER_SIZE];
+    if(replay == NULL || serial == NULL)
+        goto errout;
+    if(fread(header, sizeof(header), 1, in) != 1 || memcmp(header, CAPTURE_MAGIC, 4) != 0)
+        goto errout;
+    if(header[4] != CAPTURE_VERSION)
+        goto errout;
+
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in) - CAPTURE_HEADER_SIZE;
+    fseek(in, CAPTURE_HEADER_SIZE, SEEK_SET);
+    replay->data = malloc(size > 0 ? size : 1);
+    if(replay->data == NULL || (size > 0 && fread(replay->data, size, 1, in) != 1))
+        goto errout;
+    fclose(in);
+
+    replay->size = size;
+    replay->speed = speed;
+    replay->start = serial_now_us();
+
+    serial->fd = -1;
+    serial->baud_rate = (int)get_u32(header + 8);
+    serial->backend = &replay_backend;
+    serial->backend_data = replay;
+    return serial;
+
+errout:
+    fprintf(stderr, "error: `%s` is not a valid capture\n", path);
+    fclose(in);
+    if(replay != NULL)
+        free(replay->data);
+    free(replay);
+    free(serial);
+    return NULL;
+}
+
+serial_t *serial_open_replay_address(const char *address) {
+    // `replay:<path>` plays back in real time, `replay:<path>@<speed>` speeds it up (0 means as
+    // fast as it's read).
+    char path[1024];
+    float speed = 1.f;
+    snprintf(path, sizeof(path), "%s", address);
+
+    char *at = strrchr(path, '@');
+    if(at != NULL) {
+        char *end = NULL;
+        float val = strtof(at + 1, &end);
+        if(end != at + 1 && *end == '\0' && val >= 0.f) {
+            speed = val;
+            *at = '\0';
+        }
+    }
+    return serial_open_replay(path, speed);
+}
+
+#else
+
+bool serial_capture_start(serial_t *serial, const char *path) {
+    (void)serial;
+    (void)path;
+    return false;
+}
+
+void serial_capture_stop(serial_t *serial) {
+    (void)serial;
+}
+
+void serial_capture_record(serial_t *serial, int dir, const char *data, int len) {
+    (void)serial;
+    (void)dir;
+    (void)data;
+    (void)len;
+}
+
+serial_t *serial_open_replay(const char *path, float speed) {
+    (void)path;
+    (void)speed;
+    return NULL;
+}
+
+serial_t *serial_open_replay_address(const char *address) {
+    (void)address;
+    return NULL;
+}
+
+#endif
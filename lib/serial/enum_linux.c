@@ -0,0 +1,193 @@
+/*===--------------------------------------------------------------------------------------------===
+ * enum_linux.c
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent. All rights reserved
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#include <serial/serial.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define SYS_TTY_DIR     "/sys/class/tty"
+#define MAX_USB_DEPTH   (8)
+
+// Everything we learned about a tty the last time we saw it. sysfs gives every new device node a
+// new inode, so an entry is still valid as long as the name and inode readdir reports match.
+typedef struct {
+    char        name[64];
+    ino_t       ino;
+    unsigned    seen;
+    bool        is_usb;
+    uint16_t    vid;
+    uint16_t    pid;
+    char        product[128];
+} tty_entry_t;
+
+static pthread_mutex_t  cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static tty_entry_t      *cache = NULL;
+static int              cache_count = 0;
+static int              cache_cap = 0;
+static unsigned         scan_gen = 0;
+
+// MARK: - sysfs helpers
+
+static bool read_attr(const char *dir, const char *attr, char *out, size_t cap) {
+    char path[PATH_MAX];
+    if(snprintf(path, sizeof(path), "%s/%s", dir, attr) >= (int)sizeof(path))
+        return false;
+    
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return false;
+    ssize_t len = read(fd, out, cap - 1);
+    close(fd);
+    if(len <= 0)
+        return false;
+    
+    while(len > 0 && (out[len-1] == '\n' || out[len-1] == ' '))
+        len -= 1;
+    out[len] = '\0';
+    return len > 0;
+}
+
+static bool read_hex_attr(const char *dir, const char *attr, uint16_t *out) {
+    char buf[16];
+    if(!read_attr(dir, attr, buf, sizeof(buf)))
+        return false;
+    char *end = NULL;
+    unsigned long val = strtoul(buf, &end, 16);
+    if(end == buf || val > 0xffff)
+        return false;
+    *out = (uint16_t)val;
+    return true;
+}
+
+// Fills in the USB metadata for a tty by walking up from its device node until we hit the USB
+// device that owns it (the first ancestor with an idVendor attribute). Nothing is opened in /dev.
+static void probe_tty(tty_entry_t *entry) {
+    char link[PATH_MAX];
+    char path[PATH_MAX];
+    
+    entry->is_usb = false;
+    entry->vid = entry->pid = 0;
+    entry->product[0] = '\0';
+    
+    // Virtual consoles and ptys have no `device` link at all.
+    if(snprintf(link, sizeof(link), SYS_TTY_DIR "/%s/device", entry->name) >= (int)sizeof(link))
+        return;
+    if(realpath(link, path) == NULL)
+        return;
+    
+    for(int depth = 0; depth < MAX_USB_DEPTH; ++depth) {
+        char *slash = strrchr(path, '/');
+        if(slash == NULL || slash == path)
+            return;
+        
+        if(read_hex_attr(path, "idVendor", &entry->vid)) {
+            if(!read_hex_attr(path, "idProduct", &entry->pid))
+                return;
+            read_attr(path, "product", entry->product, sizeof(entry->product));
+            entry->is_usb = true;
+            return;
+        }
+        *slash = '\0';
+    }
+}
+
+// MARK: - Cache
+
+static tty_entry_t *cache_find(const char *name) {
+    for(int i = 0; i < cache_count; ++i) {
+        if(strcmp(cache[i].name, name) == 0)
+            return &cache[i];
+    }
+    return NULL;
+}
+
+static tty_entry_t *cache_add(const char *name) {
+    if(cache_count == cache_cap) {
+        int new_cap = cache_cap ? cache_cap * 2 : 64;
+        tty_entry_t *new_cache = realloc(cache, new_cap * sizeof(*cache));
+        if(new_cache == NULL)
+            return NULL;
+        cache = new_cache;
+        cache_cap = new_cap;
+    }
+    tty_entry_t *entry = &cache[cache_count++];
+    memset(entry, 0, sizeof(*entry));
+    snprintf(entry->name, sizeof(entry->name), "%s", name);
+    return entry;
+}
+
+static void cache_prune(void) {
+    int j = 0;
+    for(int i = 0; i < cache_count; ++i) {
+        if(cache[i].seen == scan_gen)
+            cache[j++] = cache[i];
+    }
+    cache_count = j;
+}
+
+// MARK: - Enumeration
+
+int serial_list_devices(serial_info_t *dev_info, int cap) {
+    DIR *dir = opendir(SYS_TTY_DIR);
+    if(!dir)
+        return 0;
+    
+    pthread_mutex_lock(&cache_lock);
+    scan_gen += 1;
+    
+    int count = 0;
+    struct dirent *ent;
+    while((ent = readdir(dir))) {
+        if(ent->d_name[0] == '.')
+            continue;
+        if(strlen(ent->d_name) >= sizeof(cache->name))
+            continue;
+        
+        tty_entry_t *entry = cache_find(ent->d_name);
+        if(entry == NULL || entry->ino != ent->d_ino) {
+            if(entry == NULL)
+                entry = cache_add(ent->d_name);
+            if(entry == NULL)
+                continue;
+            entry->ino = ent->d_ino;
+            probe_tty(entry);
+        }
+        entry->seen = scan_gen;
+        
+        if(!entry->is_usb || !serial_is_known_board(entry->vid, entry->pid))
+            continue;
+        
+        if(cap > 0 && count >= cap)
+            continue;
+        
+        if(cap > 0) {
+            char address[sizeof(entry->name) + 8];
+            snprintf(address, sizeof(address), "/dev/%s", entry->name);
+            
+            serial_info_t *dev = &dev_info[count];
+            dev->address = strdup(address);
+            dev->name = strdup(entry->product[0] ? entry->product : entry->name);
+            dev->vid = entry->vid;
+            dev->pid = entry->pid;
+        }
+        count += 1;
+    }
+    closedir(dir);
+    
+    cache_prune();
+    pthread_mutex_unlock(&cache_lock);
+    return count;
+}
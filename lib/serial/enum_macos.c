@@ -66,6 +66,8 @@ int serial_list_devices(serial_info_t *dev_info, int cap) {
             continue;
         if(!get_int_prop(device, CFSTR(kUSBProductID), &product_id))
             continue;
+        if(!serial_is_known_board(vendor_id, product_id))
+            continue;
         
         if(!get_str_prop(device, CFSTR(kUSBProductString), &product))
             product = NULL;
@@ -83,6 +85,8 @@ int serial_list_devices(serial_info_t *dev_info, int cap) {
             serial_info_t *dev = &dev_info[count];
             dev->address = strdup(address);
             dev->name = strdup(product);
+            dev->vid = vendor_id;
+            dev->pid = product_id;
         }
         count += 1;
     }
@@ -0,0 +1,262 @@
+/*===--------------------------------------------------------------------------------------------===
+ * hotplug.c
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent. All rights reserved
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#define _GNU_SOURCE // struct ucred
+#include "serial_impl.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define HOTPLUG_MAX_EVENTS  (32)
+#define UEVENT_BUF_SIZE     (8192)
+
+// Multicast groups on NETLINK_KOBJECT_UEVENT: raw kernel events, and the same events re-broadcast
+// by udev once its rules have run (device permissions are only usable after that).
+#define UEVENT_GROUP_KERNEL (1)
+#define UEVENT_GROUP_UDEV   (2)
+
+// Header udev puts in front of the properties it re-broadcasts (see libudev-monitor.c).
+typedef struct {
+    char        prefix[8];
+    uint32_t    magic;
+    uint32_t    header_size;
+    uint32_t    properties_off;
+    uint32_t    properties_len;
+    uint32_t    filter_subsystem_hash;
+    uint32_t    filter_devtype_hash;
+    uint32_t    filter_tag_bloom_hi;
+    uint32_t    filter_tag_bloom_lo;
+} udev_header_t;
+
+#define UDEV_MAGIC          (0xfeedcafe)
+
+struct serial_hotplug_t {
+    int                     sock;
+    int                     wakefd;
+    pthread_t               thread;
+    pthread_mutex_t         lock;
+    atomic_bool             running;
+    atomic_int              pending;
+    
+    serial_hotplug_event_t  events[HOTPLUG_MAX_EVENTS];
+    int                     head;
+};
+
+// MARK: - uevent parsing
+
+static void push_event(serial_hotplug_t *hotplug, serial_hotplug_action_t action, const char *name) {
+    pthread_mutex_lock(&hotplug->lock);
+    int count = atomic_load(&hotplug->pending);
+    if(count == HOTPLUG_MAX_EVENTS) {
+        // Drop the oldest event: the latest state of a port is the one that matters.
+        hotplug->head = (hotplug->head + 1) % HOTPLUG_MAX_EVENTS;
+        count -= 1;
+    }
+    serial_hotplug_event_t *event = &hotplug->events[(hotplug->head + count) % HOTPLUG_MAX_EVENTS];
+    event->action = action;
+    if(name[0] == '/')
+        snprintf(event->address, sizeof(event->address), "%s", name);
+    else
+        snprintf(event->address, sizeof(event->address), "/dev/%s", name);
+    atomic_store(&hotplug->pending, count + 1);
+    pthread_mutex_unlock(&hotplug->lock);
+}
+
+static void parse_uevent(serial_hotplug_t *hotplug, const char *props, size_t len) {
+    const char *action = NULL, *subsystem = NULL, *devname = NULL;
+    
+    for(size_t off = 0; off < len; off += strlen(props + off) + 1) {
+        const char *prop = props + off;
+        if(strncmp(prop, "ACTION=", 7) == 0)
+            action = prop + 7;
+        else if(strncmp(prop, "SUBSYSTEM=", 10) == 0)
+            subsystem = prop + 10;
+        else if(strncmp(prop, "DEVNAME=", 8) == 0)
+            devname = prop + 8;
+    }
+    
+    if(action == NULL || subsystem == NULL || devname == NULL)
+        return;
+    if(strcmp(subsystem, "tty") != 0)
+        return;
+    
+    if(strcmp(action, "add") == 0)
+        push_event(hotplug, SERIAL_HOTPLUG_ADDED, devname);
+    else if(strcmp(action, "remove") == 0)
+        push_event(hotplug, SERIAL_HOTPLUG_REMOVED, devname);
+}
+
+static void receive_uevent(serial_hotplug_t *hotplug) {
+    char buf[UEVENT_BUF_SIZE];
+    char control[CMSG_SPACE(sizeof(struct ucred))];
+    struct sockaddr_nl addr = {};
+    struct iovec iov = {.iov_base = buf, .iov_len = sizeof(buf) - 1};
+    struct msghdr msg = {
+        .msg_name = &addr,
+        .msg_namelen = sizeof(addr),
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control),
+    };
+    
+    ssize_t len = recvmsg(hotplug->sock, &msg, MSG_DONTWAIT);
+    if(len <= 0 || (msg.msg_flags & MSG_TRUNC))
+        return;
+    buf[len] = '\0';
+    
+    // Anyone can send on these groups, so only trust root (udev) and the kernel itself.
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if(cmsg == NULL || cmsg->cmsg_type != SCM_CREDENTIALS)
+        return;
+    struct ucred *cred = (struct ucred *)CMSG_DATA(cmsg);
+    if(cred->uid != 0)
+        return;
+    
+    if(addr.nl_groups == UEVENT_GROUP_UDEV) {
+        const udev_header_t *hdr = (const udev_header_t *)buf;
+        if((size_t)len < sizeof(*hdr) || strcmp(hdr->prefix, "libudev") != 0)
+            return;
+        if(ntohl(hdr->magic) != UDEV_MAGIC)
+            return;
+        if(hdr->properties_off + hdr->properties_len > (size_t)len)
+            return;
+        parse_uevent(hotplug, buf + hdr->properties_off, hdr->properties_len);
+    } else if(addr.nl_groups == UEVENT_GROUP_KERNEL && addr.nl_pid == 0) {
+        // Kernel events start with `action@devpath`, followed by the properties.
+        size_t head = strlen(buf) + 1;
+        if(head >= (size_t)len || strchr(buf, '@') == NULL)
+            return;
+        parse_uevent(hotplug, buf + head, len - head);
+    }
+}
+
+static void *hotplug_main(void *arg) {
+    serial_hotplug_t *hotplug = arg;
+    struct pollfd fds[2] = {
+        {.fd = hotplug->sock, .events = POLLIN},
+        {.fd = hotplug->wakefd, .events = POLLIN},
+    };
+    
+    while(atomic_load(&hotplug->running)) {
+        int rc = poll(fds, 2, -1);
+        if(rc < 0) {
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+        if(fds[0].revents & POLLIN)
+            receive_uevent(hotplug);
+    }
+    return NULL;
+}
+
+// MARK: - Public API
+
+serial_hotplug_t *serial_hotplug_new(void) {
+    serial_hotplug_t *hotplug = calloc(1, sizeof(*hotplug));
+    if(hotplug == NULL)
+        return NULL;
+    
+    hotplug->sock = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    hotplug->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(hotplug->sock < 0 || hotplug->wakefd < 0)
+        goto errout;
+    
+    int on = 1;
+    if(setsockopt(hotplug->sock, SOL_SOCKET, SO_PASSCRED, &on, sizeof(on)) < 0)
+        goto errout;
+    
+    struct sockaddr_nl addr = {
+        .nl_family = AF_NETLINK,
+        .nl_groups = UEVENT_GROUP_KERNEL | UEVENT_GROUP_UDEV,
+    };
+    if(bind(hotplug->sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        goto errout;
+    
+    pthread_mutex_init(&hotplug->lock, NULL);
+    atomic_init(&hotplug->running, true);
+    atomic_init(&hotplug->pending, 0);
+    
+    if(pthread_create(&hotplug->thread, NULL, hotplug_main, hotplug) != 0) {
+        pthread_mutex_destroy(&hotplug->lock);
+        goto errout;
+    }
+    return hotplug;
+    
+errout:
+    if(hotplug->sock >= 0)
+        close(hotplug->sock);
+    if(hotplug->wakefd >= 0)
+        close(hotplug->wakefd);
+    free(hotplug);
+    return NULL;
+}
+
+void serial_hotplug_destroy(serial_hotplug_t *hotplug) {
+    if(hotplug == NULL)
+        return;
+    atomic_store(&hotplug->running, false);
+    uint64_t one = 1;
+    ssize_t rc = write(hotplug->wakefd, &one, sizeof(one));
+    (void)rc;
+    pthread_join(hotplug->thread, NULL);
+    
+    close(hotplug->sock);
+    close(hotplug->wakefd);
+    pthread_mutex_destroy(&hotplug->lock);
+    free(hotplug);
+}
+
+int serial_hotplug_poll(serial_hotplug_t *hotplug, serial_hotplug_event_t *events, int cap) {
+    if(hotplug == NULL || atomic_load(&hotplug->pending) == 0)
+        return 0;
+    
+    pthread_mutex_lock(&hotplug->lock);
+    int count = atomic_load(&hotplug->pending);
+    if(count > cap)
+        count = cap;
+    for(int i = 0; i < count; ++i) {
+        events[i] = hotplug->events[hotplug->head];
+        hotplug->head = (hotplug->head + 1) % HOTPLUG_MAX_EVENTS;
+    }
+    atomic_store(&hotplug->pending, atomic_load(&hotplug->pending) - count);
+    pthread_mutex_unlock(&hotplug->lock);
+    return count;
+}
+
+#else
+
+serial_hotplug_t *serial_hotplug_new(void) {
+    return NULL;
+}
+
+void serial_hotplug_destroy(serial_hotplug_t *hotplug) {
+    (void)hotplug;
+}
+
+int serial_hotplug_poll(serial_hotplug_t *hotplug, serial_hotplug_event_t *events, int cap) {
+    (void)hotplug;
+    (void)events;
+    (void)cap;
+    return 0;
+}
+
+#endif
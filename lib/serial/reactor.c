@@ -0,0 +1,450 @@
+/*===--------------------------------------------------------------------------------------------===
+ * reactor.c
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent. All rights reserved
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#include "serial_impl.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#define REACTOR_MAX_EVENTS  (32)
+#define PORT_RX_CAP         (16384)
+#define PORT_TX_CAP         (8192)
+
+typedef struct {
+    char    *data;
+    int     size;
+    int     cap;
+} port_buf_t;
+
+typedef struct {
+    serial_reactor_t *reactor;
+    serial_t        *serial;
+    int             fd;
+    uint32_t        events;
+    bool            registered;
+    bool            lost;
+    port_buf_t      rx;
+    port_buf_t      tx;
+    uint64_t        rx_time;        // When the oldest byte in `rx` arrived
+} serial_port_t;
+
+struct serial_reactor_t {
+    int             epfd;
+    int             wakefd;
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  rx_cond;
+    atomic_bool     running;
+    atomic_bool     kicked;
+    
+    serial_port_t   **ports;
+    int             port_count;
+    int             port_cap;
+};
+
+static int reactor_port_read(serial_t *serial, char *buffer, int cap);
+static int reactor_port_write(serial_t *serial, const char *buffer, int num);
+static int reactor_port_poll(serial_t *serial, int timeout_ms);
+static void reactor_port_detach(serial_t *serial);
+
+static const serial_backend_t reactor_backend = {
+    .read = reactor_port_read,
+    .write = reactor_port_write,
+    .poll = reactor_port_poll,
+    .detach = reactor_port_detach,
+    .captures = true,
+};
+
+// MARK: - Port buffers
+
+static void port_buf_init(port_buf_t *buf, int cap) {
+    buf->data = malloc(cap);
+    buf->size = 0;
+    buf->cap = buf->data ? cap : 0;
+}
+
+static void port_buf_fini(port_buf_t *buf) {
+    free(buf->data);
+    buf->data = NULL;
+    buf->size = buf->cap = 0;
+}
+
+static void port_buf_pop(port_buf_t *buf, int num) {
+    memmove(buf->data, buf->data + num, buf->size - num);
+    buf->size -= num;
+}
+
+// MARK: - Reactor thread (called with the lock held)
+
+static void reactor_kick(serial_reactor_t *reactor) {
+    if(atomic_exchange(&reactor->kicked, true))
+        return;
+    uint64_t one = 1;
+    SERIAL_SYSCALL();
+    ssize_t rc = write(reactor->wakefd, &one, sizeof(one));
+    (void)rc;
+}
+
+static serial_port_t *find_port(serial_reactor_t *reactor, int fd) {
+    for(int i = 0; i < reactor->port_count; ++i) {
+        if(reactor->ports[i]->fd == fd)
+            return reactor->ports[i];
+    }
+    return NULL;
+}
+
+static void port_update_events(serial_reactor_t *reactor, serial_port_t *port) {
+    if(port->lost) {
+        // Error/hangup are always reported, so a lost port must leave the interest list entirely.
+        if(port->registered)
+            epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, port->fd, NULL);
+        port->registered = false;
+        return;
+    }
+    
+    uint32_t events = 0;
+    if(port->rx.size < port->rx.cap)
+        events |= EPOLLIN;
+    if(port->tx.size > 0)
+        events |= EPOLLOUT;
+    if(events == port->events && port->registered)
+        return;
+    
+    SERIAL_SYSCALL();
+    struct epoll_event ev = {.events = events, .data.fd = port->fd};
+    int op = port->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if(epoll_ctl(reactor->epfd, op, port->fd, &ev) < 0) {
+        port->lost = true;
+        return;
+    }
+    port->registered = true;
+    port->events = events;
+}
+
+static void port_fill(serial_port_t *port) {
+    int total = 0;
+    while(port->rx.size < port->rx.cap) {
+        SERIAL_SYSCALL();
+        ssize_t len = read(port->fd, port->rx.data + port->rx.size, port->rx.cap - port->rx.size);
+        if(len > 0) {
+            if(port->rx.size == 0)
+                port->rx_time = serial_now_us();
+            if(port->serial->capture != NULL)
+                serial_capture_record(port->serial, CAPTURE_RX, port->rx.data + port->rx.size, len);
+            port->rx.size += len;
+            total += len;
+            continue;
+        }
+        // Readable but at end of file means the other end hung up.
+        if(len == 0 && total == 0)
+            port->lost = true;
+        if(len < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            port->lost = true;
+        break;
+    }
+}
+
+static void port_flush(serial_port_t *port) {
+    int sent = 0;
+    while(sent < port->tx.size) {
+        SERIAL_SYSCALL();
+        ssize_t len = write(port->fd, port->tx.data + sent, port->tx.size - sent);
+        if(len > 0) {
+            if(port->serial->capture != NULL)
+                serial_capture_record(port->serial, CAPTURE_TX, port->tx.data + sent, len);
+            sent += len;
+            continue;
+        }
+        if(len < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            port->lost = true;
+        break;
+    }
+    port_buf_pop(&port->tx, sent);
+}
+
+static void *reactor_main(void *arg) {
+    serial_reactor_t *reactor = arg;
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    
+    while(atomic_load(&reactor->running)) {
+        SERIAL_SYSCALL();
+        int count = epoll_wait(reactor->epfd, events, REACTOR_MAX_EVENTS, -1);
+        if(count < 0) {
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+        
+        pthread_mutex_lock(&reactor->lock);
+        for(int i = 0; i < count; ++i) {
+            if(events[i].data.fd == reactor->wakefd) {
+                uint64_t val;
+                SERIAL_SYSCALL();
+                ssize_t rc = read(reactor->wakefd, &val, sizeof(val));
+                (void)rc;
+                atomic_store(&reactor->kicked, false);
+                
+                // New output gets written straight away rather than waiting for EPOLLOUT.
+                for(int j = 0; j < reactor->port_count; ++j) {
+                    serial_port_t *port = reactor->ports[j];
+                    if(port->tx.size > 0 && !port->lost)
+                        port_flush(port);
+                    port_update_events(reactor, port);
+                }
+                continue;
+            }
+            
+            // The port might have been removed while we were waiting.
+            serial_port_t *port = find_port(reactor, events[i].data.fd);
+            if(port == NULL)
+                continue;
+            if(events[i].events & EPOLLIN)
+                port_fill(port);
+            if(events[i].events & EPOLLOUT)
+                port_flush(port);
+            if(events[i].events & (EPOLLERR | EPOLLHUP))
+                port->lost = true;
+            port_update_events(reactor, port);
+        }
+        pthread_cond_broadcast(&reactor->rx_cond);
+        pthread_mutex_unlock(&reactor->lock);
+    }
+    return NULL;
+}
+
+// MARK: - Public API
+
+serial_reactor_t *serial_reactor_new(void) {
+    serial_reactor_t *reactor = calloc(1, sizeof(*reactor));
+    if(reactor == NULL)
+        return NULL;
+    
+    reactor->epfd = epoll_create1(EPOLL_CLOEXEC);
+    reactor->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(reactor->epfd < 0 || reactor->wakefd < 0)
+        goto errout;
+    
+    struct epoll_event ev = {.events = EPOLLIN, .data.fd = reactor->wakefd};
+    if(epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, reactor->wakefd, &ev) < 0)
+        goto errout;
+    
+    pthread_mutex_init(&reactor->lock, NULL);
+    pthread_cond_init(&reactor->rx_cond, NULL);
+    atomic_init(&reactor->running, true);
+    atomic_init(&reactor->kicked, false);
+    
+    if(pthread_create(&reactor->thread, NULL, reactor_main, reactor) != 0) {
+        pthread_mutex_destroy(&reactor->lock);
+        pthread_cond_destroy(&reactor->rx_cond);
+        goto errout;
+    }
+    return reactor;
+    
+errout:
+    if(reactor->epfd >= 0)
+        close(reactor->epfd);
+    if(reactor->wakefd >= 0)
+        close(reactor->wakefd);
+    free(reactor);
+    return NULL;
+}
+
+void serial_reactor_destroy(serial_reactor_t *reactor) {
+    if(reactor == NULL)
+        return;
+    atomic_store(&reactor->running, false);
+    atomic_store(&reactor->kicked, false);
+    reactor_kick(reactor);
+    pthread_join(reactor->thread, NULL);
+    
+    while(reactor->port_count > 0)
+        serial_reactor_remove(reactor, reactor->ports[0]->serial);
+    free(reactor->ports);
+    
+    close(reactor->epfd);
+    close(reactor->wakefd);
+    pthread_mutex_destroy(&reactor->lock);
+    pthread_cond_destroy(&reactor->rx_cond);
+    free(reactor);
+}
+
+bool serial_reactor_add(serial_reactor_t *reactor, serial_t *serial) {
+    if(reactor == NULL || serial == NULL)
+        return false;
+    if(serial->backend != NULL) {
+        return serial->backend == &reactor_backend
+            && ((serial_port_t *)serial->backend_data)->reactor == reactor;
+    }
+    
+    serial_port_t *port = calloc(1, sizeof(*port));
+    if(port == NULL)
+        return false;
+    port->reactor = reactor;
+    port->serial = serial;
+    port->fd = serial->fd;
+    port_buf_init(&port->rx, PORT_RX_CAP);
+    port_buf_init(&port->tx, PORT_TX_CAP);
+    
+    pthread_mutex_lock(&reactor->lock);
+    if(reactor->port_count == reactor->port_cap) {
+        int cap = reactor->port_cap ? reactor->port_cap * 2 : 8;
+        serial_port_t **ports = realloc(reactor->ports, cap * sizeof(*ports));
+        if(ports == NULL)
+            goto errout;
+        reactor->ports = ports;
+        reactor->port_cap = cap;
+    }
+    port_update_events(reactor, port);
+    if(port->lost)
+        goto errout;
+    
+    reactor->ports[reactor->port_count++] = port;
+    serial->backend = &reactor_backend;
+    serial->backend_data = port;
+    pthread_mutex_unlock(&reactor->lock);
+    return true;
+    
+errout:
+    pthread_mutex_unlock(&reactor->lock);
+    port_buf_fini(&port->rx);
+    port_buf_fini(&port->tx);
+    free(port);
+    return false;
+}
+
+void serial_reactor_remove(serial_reactor_t *reactor, serial_t *serial) {
+    if(reactor == NULL || serial == NULL || serial->backend != &reactor_backend)
+        return;
+    serial_port_t *port = serial->backend_data;
+    if(port->reactor != reactor)
+        return;
+    
+    pthread_mutex_lock(&reactor->lock);
+    for(int i = 0; i < reactor->port_count; ++i) {
+        if(reactor->ports[i] != port)
+            continue;
+        memmove(&reactor->ports[i], &reactor->ports[i + 1],
+                (reactor->port_count - i - 1) * sizeof(*reactor->ports));
+        reactor->port_count -= 1;
+        break;
+    }
+    if(port->registered)
+        epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, port->fd, NULL);
+    // Best effort: don't drop output that was queued just before the port was handed back.
+    if(!port->lost && port->tx.size > 0)
+        port_flush(port);
+    pthread_mutex_unlock(&reactor->lock);
+    
+    serial->backend = NULL;
+    serial->backend_data = NULL;
+    port_buf_fini(&port->rx);
+    port_buf_fini(&port->tx);
+    free(port);
+}
+
+// MARK: - Port I/O (called from serial.c)
+
+static void reactor_port_detach(serial_t *serial) {
+    serial_port_t *port = serial->backend_data;
+    serial_reactor_remove(port->reactor, serial);
+}
+
+static int reactor_port_read(serial_t *serial, char *buffer, int cap) {
+    serial_port_t *port = serial->backend_data;
+    serial_reactor_t *reactor = port->reactor;
+    
+    pthread_mutex_lock(&reactor->lock);
+    bool was_full = port->rx.size == port->rx.cap;
+    int len = port->rx.size < cap ? port->rx.size : cap;
+    memcpy(buffer, port->rx.data, len);
+    port_buf_pop(&port->rx, len);
+    serial->rx_time = port->rx_time;
+    if(len == 0 && port->lost)
+        len = -1;
+    pthread_mutex_unlock(&reactor->lock);
+    
+    // The reactor stops listening to ports with a full buffer; let it know there's room again.
+    if(was_full && len > 0)
+        reactor_kick(reactor);
+    return len;
+}
+
+static int reactor_port_write(serial_t *serial, const char *buffer, int num) {
+    serial_port_t *port = serial->backend_data;
+    serial_reactor_t *reactor = port->reactor;
+    
+    pthread_mutex_lock(&reactor->lock);
+    int len = -1;
+    if(!port->lost) {
+        len = port->tx.cap - port->tx.size;
+        if(len > num)
+            len = num;
+        memcpy(port->tx.data + port->tx.size, buffer, len);
+        port->tx.size += len;
+    }
+    pthread_mutex_unlock(&reactor->lock);
+    
+    if(len > 0)
+        reactor_kick(reactor);
+    return len;
+}
+
+static int reactor_port_poll(serial_t *serial, int timeout_ms) {
+    serial_port_t *port = serial->backend_data;
+    serial_reactor_t *reactor = port->reactor;
+    
+    struct timespec limit;
+    clock_gettime(CLOCK_REALTIME, &limit);
+    limit.tv_sec += timeout_ms / 1000;
+    limit.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if(limit.tv_nsec >= 1000000000L) {
+        limit.tv_sec += 1;
+        limit.tv_nsec -= 1000000000L;
+    }
+    
+    pthread_mutex_lock(&reactor->lock);
+    while(timeout_ms > 0 && port->rx.size == 0 && !port->lost) {
+        if(pthread_cond_timedwait(&reactor->rx_cond, &reactor->lock, &limit) == ETIMEDOUT)
+            break;
+    }
+    int rc = port->rx.size > 0 ? 1 : (port->lost ? -1 : 0);
+    pthread_mutex_unlock(&reactor->lock);
+    return rc;
+}
+
+#else
+
+serial_reactor_t *serial_reactor_new(void) {
+    return NULL;
+}
+
+void serial_reactor_destroy(serial_reactor_t *reactor) {
+    (void)reactor;
+}
+
+bool serial_reactor_add(serial_reactor_t *reactor, serial_t *serial) {
+    (void)reactor;
+    (void)serial;
+    return false;
+}
+
+void serial_reactor_remove(serial_reactor_t *reactor, serial_t *serial) {
+    (void)reactor;
+    (void)serial;
+}
+
+#endif
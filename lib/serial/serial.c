@@ -7,42 +7,46 @@
  * Licensed under the MIT License
  *===--------------------------------------------------------------------------------------------===
 */
-#include <serial/serial.h>
+#include "serial_impl.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <errno.h>
 
-#if defined(__APPLE__) || defined(__linux__)
-#define USE_POSIX   (1)
-#define USE_WIN32   (0)
-
+#if USE_POSIX
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <termios.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <time.h>
 #include <unistd.h>
-
-#else
-#define USE_POSIX   (0)
-#define USE_WIN32   (1)
 #endif
 
-
-
-struct serial_t {
-#if USE_POSIX
-    int fd;
-#else
-#error "non-posix platforms not (yet) supported"
+#ifdef SERIAL_COUNT_SYSCALLS
+atomic_ulong serial_syscall_count = 0;
 #endif
+
+static const int baud_rates[] = {
+    [SERIAL_BAUDS_300] = 300,
+    [SERIAL_BAUDS_600] = 600,
+    [SERIAL_BAUDS_1200] = 1200,
+    [SERIAL_BAUDS_2400] = 2400,
+    [SERIAL_BAUDS_4800] = 4800,
+    [SERIAL_BAUDS_9600] = 9600,
+    [SERIAL_BAUDS_19200] = 19200,
+    [SERIAL_BAUDS_38400] = 38400,
+    [SERIAL_BAUDS_57600] = 57600,
+    [SERIAL_BAUDS_115200] = 115200,
 };
 
 serial_t *serial_open(const char *address, serial_speed_t speed_bds) {
+    if(strncmp(address, SERIAL_REPLAY_PREFIX, strlen(SERIAL_REPLAY_PREFIX)) == 0)
+        return serial_open_replay_address(address + strlen(SERIAL_REPLAY_PREFIX));
 #if USE_POSIX
     struct termios options = {};
-    speed_t speed;
+    speed_t speed = B115200;
     
     
     int fd = open(address, O_RDWR | O_NOCTTY | O_NDELAY);
@@ -55,16 +59,16 @@ serial_t *serial_open(const char *address, serial_speed_t speed_bds) {
     memset(&options, 0, sizeof(options));
     
     switch(speed_bds) {
-        case SERIAL_BAUDS_300: speed = B300;
-        case SERIAL_BAUDS_600: speed = B600;
-        case SERIAL_BAUDS_1200: speed = B1200;
-        case SERIAL_BAUDS_2400: speed = B2400;
-        case SERIAL_BAUDS_4800: speed = B4800;
-        case SERIAL_BAUDS_9600: speed = B9600;
-        case SERIAL_BAUDS_19200: speed = B19200;
-        case SERIAL_BAUDS_38400: speed = B38400;
-        case SERIAL_BAUDS_57600: speed = B57600;
-        case SERIAL_BAUDS_115200: speed = B115200;
+        case SERIAL_BAUDS_300: speed = B300; break;
+        case SERIAL_BAUDS_600: speed = B600; break;
+        case SERIAL_BAUDS_1200: speed = B1200; break;
+        case SERIAL_BAUDS_2400: speed = B2400; break;
+        case SERIAL_BAUDS_4800: speed = B4800; break;
+        case SERIAL_BAUDS_9600: speed = B9600; break;
+        case SERIAL_BAUDS_19200: speed = B19200; break;
+        case SERIAL_BAUDS_38400: speed = B38400; break;
+        case SERIAL_BAUDS_57600: speed = B57600; break;
+        case SERIAL_BAUDS_115200: speed = B115200; break;
     }
     int databits_flag = CS8; // 8 data bits
     int stopbits_flag = 0; // 1 stop bit
@@ -79,17 +83,40 @@ serial_t *serial_open(const char *address, serial_speed_t speed_bds) {
     options.c_cc[VMIN] = 0;
     tcsetattr(fd, TCSANOW, &options);
     
-    serial_t *serial = calloc(1, sizeof(serial));
+    serial_t *serial = calloc(1, sizeof(*serial));
     if(serial == NULL)
         return NULL;
     serial->fd = fd;
+    serial->baud_rate = baud_rates[speed_bds];
     return serial;
 #else
     return NULL;
 #endif
 }
 
+int serial_get_baud_rate(const serial_t *serial) {
+    return serial->baud_rate;
+}
+
+uint64_t serial_get_rx_time(const serial_t *serial) {
+    return serial->rx_time;
+}
+
+uint64_t serial_now_us(void) {
+#if USE_POSIX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return 0;
+#endif
+}
+
 void serial_close(serial_t *serial) {
+    // Backends can record from their own thread until they let go of the port.
+    if(serial->backend != NULL)
+        serial->backend->detach(serial);
+    serial_capture_stop(serial);
 #if USE_POSIX
     close(serial->fd);
     serial->fd = -1;
@@ -99,23 +126,99 @@ void serial_close(serial_t *serial) {
     free(serial);
 }
 
-int serial_read(serial_t *serial, char *buffer, int cap) {
+static bool should_capture(const serial_t *serial) {
+    return serial->capture != NULL && (serial->backend == NULL || !serial->backend->captures);
+}
+
+static int port_read(serial_t *serial, char *buffer, int cap) {
+    if(serial->backend != NULL)
+        return serial->backend->read(serial, buffer, cap);
+#if USE_POSIX
+    SERIAL_SYSCALL();
+    int len = (int)read(serial->fd, buffer, cap);
+    // The port is non-blocking: no data available isn't an error.
+    if(len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return 0;
+    if(len > 0)
+        serial->rx_time = serial_now_us();
+    return len;
+#else
+    return 0;
+#endif
+}
+
+static int port_write(serial_t *serial, const char *buffer, int num) {
+    if(serial->backend != NULL)
+        return serial->backend->write(serial, buffer, num);
 #if USE_POSIX
-    return (int)read(serial->fd, buffer, cap);
+    SERIAL_SYSCALL();
+    int len = (int)write(serial->fd, buffer, num);
+    if(len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return 0;
+    return len;
 #else
     return 0;
 #endif
 }
 
+int serial_read(serial_t *serial, char *buffer, int cap) {
+    int len = port_read(serial, buffer, cap);
+    if(len > 0 && should_capture(serial))
+        serial_capture_record(serial, CAPTURE_RX, buffer, len);
+    return len;
+}
+
 int serial_write(serial_t *serial, const char *buffer, int num) {
+    int len = port_write(serial, buffer, num);
+    if(len > 0 && should_capture(serial))
+        serial_capture_record(serial, CAPTURE_TX, buffer, len);
+    return len;
+}
+
+int serial_poll(serial_t *serial, int timeout_ms) {
+    if(serial->backend != NULL)
+        return serial->backend->poll(serial, timeout_ms);
 #if USE_POSIX
-    return (int)write(serial->fd, buffer, num);
+    SERIAL_SYSCALL();
+    struct pollfd pfd = {.fd = serial->fd, .events = POLLIN};
+    int rc = poll(&pfd, 1, timeout_ms);
+    if(rc < 0)
+        return errno == EINTR ? 0 : -1;
+    if(rc == 0)
+        return 0;
+    if(pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+        return -1;
+    return 1;
 #else
     return 0;
 #endif
 }
 
 
+// A product ID of zero matches anything from that vendor.
+static const struct {
+    uint16_t vid;
+    uint16_t pid;
+} known_boards[] = {
+    {0x2341, 0x0000},   // Arduino
+    {0x2a03, 0x0000},   // Arduino (arduino.org)
+    {0x1b4f, 0x0000},   // SparkFun Pro Micro
+    {0x2e8a, 0x0000},   // Raspberry Pi Pico
+    {0x1a86, 0x7523},   // CH340 (Mega and Nano clones)
+    {0x0403, 0x6001},   // FT232R
+    {0x10c4, 0xea60},   // CP210x
+};
+
+bool serial_is_known_board(uint16_t vid, uint16_t pid) {
+    for(size_t i = 0; i < sizeof(known_boards)/sizeof(*known_boards); ++i) {
+        if(known_boards[i].vid != vid)
+            continue;
+        if(known_boards[i].pid == 0 || known_boards[i].pid == pid)
+            return true;
+    }
+    return false;
+}
+
 void serial_free_list(serial_info_t *dev_info, int num) {
     for(int i = 0; i < num; ++i) {
         free(dev_info[i].address);
@@ -10,6 +10,7 @@
 #ifndef _UART_H_
 #define _UART_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -18,12 +19,27 @@ extern "C" {
 #endif
 
 typedef struct serial_t serial_t;
+typedef struct serial_reactor_t serial_reactor_t;
+typedef struct serial_uring_t serial_uring_t;
+typedef struct serial_hotplug_t serial_hotplug_t;
 
 typedef struct {
-    char *address;
-    char *name;
+    char        *address;
+    char        *name;
+    uint16_t    vid;
+    uint16_t    pid;
 } serial_info_t;
 
+typedef enum {
+    SERIAL_HOTPLUG_ADDED,
+    SERIAL_HOTPLUG_REMOVED,
+} serial_hotplug_action_t;
+
+typedef struct {
+    serial_hotplug_action_t action;
+    char                    address[64];
+} serial_hotplug_event_t;
+
 typedef enum {
     SERIAL_BAUDS_300,
     SERIAL_BAUDS_600,
@@ -38,15 +54,78 @@ typedef enum {
 } serial_speed_t;
 
 
+// Lists the serial ports that belong to a known MobiFlight-capable board (see
+// serial_is_known_board), without opening any of them. If `cap` is zero, only counts them.
 int serial_list_devices(serial_info_t *dev_info, int cap);
 void serial_free_list(serial_info_t *dev_info, int num);
 
+// Whether a USB VID/PID pair belongs to an Arduino, an Arduino clone USB-serial bridge, or a
+// Raspberry Pi Pico, which are the boards the MobiFlight firmware runs on.
+bool serial_is_known_board(uint16_t vid, uint16_t pid);
+
 serial_t *serial_open(const char *address, serial_speed_t speed);
 void serial_close(serial_t *serial);
 
+// The line speed the port was opened with, in bits per second.
+int serial_get_baud_rate(const serial_t *serial);
+
 int serial_read(serial_t *serial, char *buffer, int cap);
 int serial_write(serial_t *serial, const char *buffer, int num);
 
+// When the oldest byte returned by the last serial_read came off the port, in serial_now_us() time.
+// The reactor stamps bytes on its own thread as they arrive. io_uring stamps them when a completion
+// is reaped, and plain ports when they are read.
+uint64_t serial_get_rx_time(const serial_t *serial);
+uint64_t serial_now_us(void);
+
+// Capture: every chunk read from or written to the port is appended to `path` with a monotonic
+// timestamp, in a compact binary format (see capture.c).
+bool serial_capture_start(serial_t *serial, const char *path);
+void serial_capture_stop(serial_t *serial);
+
+// Replay: a port that plays the received side of a capture back, chunk by chunk, `speed` times
+// faster than it was recorded (0 plays it as fast as it's read). Writes are accepted and dropped.
+// Once the capture is exhausted, the port stays open but never has anything to read. serial_open
+// also opens replays for addresses like `replay:<path>` or `replay:<path>@<speed>`.
+#define SERIAL_REPLAY_PREFIX "replay:"
+serial_t *serial_open_replay(const char *path, float speed);
+
+// Waits up to `timeout_ms` for data to be available. Returns 1 if the port is readable, 0 on
+// timeout, and -1 if the port has been lost.
+int serial_poll(serial_t *serial, int timeout_ms);
+
+// Event-driven backend: a single background thread waits on every registered port with epoll,
+// reads only the ports that have data, and writes queued output when a port becomes writable.
+// While registered, serial_read/serial_write/serial_poll only touch in-memory buffers. Closing a
+// port removes it from its reactor. Only available on Linux: serial_reactor_new returns NULL
+// elsewhere.
+serial_reactor_t *serial_reactor_new(void);
+void serial_reactor_destroy(serial_reactor_t *reactor);
+bool serial_reactor_add(serial_reactor_t *reactor, serial_t *serial);
+void serial_reactor_remove(serial_reactor_t *reactor, serial_t *serial);
+
+// io_uring backend: every registered port keeps a read outstanding, and serial_write only queues
+// data. serial_uring_flush submits all queued writes and re-arms reads for every port in a single
+// io_uring_enter, so it should be called once per frame after all ports have been serviced. Not
+// thread-safe: use from a single thread. Only available on Linux 5.11+: serial_uring_new returns
+// NULL elsewhere.
+serial_uring_t *serial_uring_new(int max_ports);
+void serial_uring_destroy(serial_uring_t *ring);
+bool serial_uring_add(serial_uring_t *ring, serial_t *serial);
+void serial_uring_remove(serial_uring_t *ring, serial_t *serial);
+int serial_uring_flush(serial_uring_t *ring);
+
+// Hotplug watcher: a background thread listens to kernel (and udev, when it runs) uevents over
+// netlink and queues an event whenever a tty device node appears or disappears. Events for a port
+// that was just added can arrive before udev has fixed its permissions, so opening it may still
+// fail until the udev copy of the event comes in. Only available on Linux: serial_hotplug_new
+// returns NULL elsewhere.
+serial_hotplug_t *serial_hotplug_new(void);
+void serial_hotplug_destroy(serial_hotplug_t *hotplug);
+
+// Pops up to `cap` queued events without blocking. Returns the number of events copied.
+int serial_hotplug_poll(serial_hotplug_t *hotplug, serial_hotplug_event_t *events, int cap);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,62 @@
+/*===--------------------------------------------------------------------------------------------===
+ * serial_impl.h
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#ifndef _SERIAL_IMPL_H_
+#define _SERIAL_IMPL_H_
+
+#include <serial/serial.h>
+
+#if defined(__APPLE__) || defined(__linux__)
+#define USE_POSIX   (1)
+#define USE_WIN32   (0)
+#else
+#define USE_POSIX   (0)
+#define USE_WIN32   (1)
+#endif
+
+// When a port is registered with a reactor or an io_uring, reads and writes are served from the
+// backend's buffers instead of going to the file descriptor. Those backends set `captures` and
+// record traffic themselves, when it actually goes over the wire.
+typedef struct {
+    int (*read)(serial_t *serial, char *buffer, int cap);
+    int (*write)(serial_t *serial, const char *buffer, int num);
+    int (*poll)(serial_t *serial, int timeout_ms);
+    void (*detach)(serial_t *serial);
+    bool captures;
+} serial_backend_t;
+
+struct serial_t {
+#if USE_POSIX
+    int fd;
+#else
+#error "non-posix platforms not (yet) supported"
+#endif
+    int                     baud_rate;
+    const serial_backend_t  *backend;
+    void                    *backend_data;
+    struct serial_capture_t *capture;
+    uint64_t                rx_time;    // Set by serial_read, or by the backend's read
+};
+
+#define CAPTURE_RX  (0)
+#define CAPTURE_TX  (1)
+
+void serial_capture_record(serial_t *serial, int dir, const char *data, int len);
+serial_t *serial_open_replay_address(const char *address);
+
+// Benchmarks build the library with this defined to see how many syscalls each backend makes.
+#ifdef SERIAL_COUNT_SYSCALLS
+#include <stdatomic.h>
+extern atomic_ulong serial_syscall_count;
+#define SERIAL_SYSCALL()    atomic_fetch_add_explicit(&serial_syscall_count, 1, memory_order_relaxed)
+#else
+#define SERIAL_SYSCALL()
+#endif
+
+#endif /* ifndef _SERIAL_IMPL_H_ */
@@ -0,0 +1,617 @@
+/*===--------------------------------------------------------------------------------------------===
+ * uring.c
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent. All rights reserved
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#include "serial_impl.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// We talk to the kernel directly rather than pull in liburing: we only need a handful of opcodes.
+
+#define URING_READ_CHUNK    (512)
+#define URING_RX_CAP        (16384)
+#define URING_TX_CAP        (8192)
+#define URING_CANCEL_MS     (250)
+
+// The low bits of each SQE's user data say which operation completed.
+#define OP_POLL             (1)
+#define OP_READ             (2)
+#define OP_WRITE            (3)
+#define OP_MASK             (3)
+
+typedef struct uring_port_t {
+    serial_uring_t  *ring;
+    serial_t        *serial;
+    int             fd;
+    bool            lost;
+    bool            closing;
+    bool            orphaned;       // Removed, but the kernel still holds requests into it
+    bool            read_armed;
+    int             write_len;      // Bytes at the front of `tx` owned by an in-flight write
+    int             inflight;
+    
+    char            *rx;
+    int             rx_size;
+    uint64_t        rx_time;        // When the oldest byte in `rx` was reaped
+    char            *tx;
+    int             tx_size;
+    char            chunk[URING_READ_CHUNK];
+    struct uring_port_t *next_orphan;
+} uring_port_t;
+
+struct serial_uring_t {
+    int                 fd;
+    
+    unsigned            *sq_head;
+    unsigned            *sq_tail;
+    unsigned            *sq_mask;
+    unsigned            *sq_array;
+    unsigned            sq_entries;
+    unsigned            sq_local_tail;
+    unsigned            to_submit;
+    struct io_uring_sqe *sqes;
+    
+    unsigned            *cq_head;
+    unsigned            *cq_tail;
+    unsigned            *cq_mask;
+    struct io_uring_cqe *cqes;
+    
+    void                *sq_map;
+    size_t              sq_map_size;
+    void                *cq_map;
+    size_t              cq_map_size;
+    void                *sqe_map;
+    size_t              sqe_map_size;
+    
+    uring_port_t        **ports;
+    int                 port_count;
+    int                 port_cap;
+    uring_port_t        *orphans;
+};
+
+static int uring_port_read(serial_t *serial, char *buffer, int cap);
+static int uring_port_write(serial_t *serial, const char *buffer, int num);
+static int uring_port_poll(serial_t *serial, int timeout_ms);
+static void uring_port_detach(serial_t *serial);
+
+static const serial_backend_t uring_backend = {
+    .read = uring_port_read,
+    .write = uring_port_write,
+    .poll = uring_port_poll,
+    .detach = uring_port_detach,
+    .captures = true,
+};
+
+// MARK: - Ring plumbing
+
+static int ring_enter(serial_uring_t *ring, unsigned submit, unsigned wait, unsigned flags,
+                      void *arg, size_t arg_size) {
+    SERIAL_SYSCALL();
+    return (int)syscall(__NR_io_uring_enter, ring->fd, submit, wait, flags, arg, arg_size);
+}
+
+static int ring_submit(serial_uring_t *ring, unsigned wait) {
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    if(ring->to_submit == 0 && wait == 0)
+        return 0;
+    
+    int rc;
+    do {
+        rc = ring_enter(ring, ring->to_submit, wait, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    } while(rc < 0 && errno == EINTR);
+    if(rc < 0)
+        return -1;
+    ring->to_submit -= (unsigned)rc < ring->to_submit ? (unsigned)rc : ring->to_submit;
+    return rc;
+}
+
+static struct io_uring_sqe *ring_get_sqes(serial_uring_t *ring, unsigned count) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if(ring->sq_local_tail + count - head > ring->sq_entries) {
+        ring_submit(ring, 0);
+        head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        if(ring->sq_local_tail + count - head > ring->sq_entries)
+            return NULL;
+    }
+    
+    // Linked requests must be contiguous in the submission order, which the array guarantees.
+    struct io_uring_sqe *first = NULL;
+    for(unsigned i = 0; i < count; ++i) {
+        unsigned idx = ring->sq_local_tail & *ring->sq_mask;
+        struct io_uring_sqe *sqe = &ring->sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        ring->sq_array[idx] = idx;
+        ring->sq_local_tail += 1;
+        ring->to_submit += 1;
+        if(first == NULL)
+            first = sqe;
+    }
+    return first;
+}
+
+// Like ring_submit(ring, 1), but gives up after `timeout_ms`. Returns false on timeout or error.
+static bool ring_wait(serial_uring_t *ring, int timeout_ms) {
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    struct __kernel_timespec ts = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_nsec = (timeout_ms % 1000) * 1000000L,
+    };
+    struct io_uring_getevents_arg arg = {
+        .sigmask = 0,
+        .sigmask_sz = _NSIG / 8,
+        .ts = (uint64_t)(uintptr_t)&ts,
+    };
+    int rc = ring_enter(ring, ring->to_submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                        &arg, sizeof(arg));
+    if(rc < 0)
+        return errno == EINTR;
+    ring->to_submit -= (unsigned)rc < ring->to_submit ? (unsigned)rc : ring->to_submit;
+    return true;
+}
+
+static struct io_uring_sqe *ring_next_sqe(serial_uring_t *ring, struct io_uring_sqe *sqe) {
+    unsigned idx = (unsigned)(sqe - ring->sqes);
+    return &ring->sqes[(idx + 1) & *ring->sq_mask];
+}
+
+// Captures are timed here, when the kernel hands the data over, not when the caller gets to it.
+static void port_record(uring_port_t *port, int dir, const char *data, int len) {
+    if(port->serial != NULL && port->serial->capture != NULL)
+        serial_capture_record(port->serial, dir, data, len);
+}
+
+static void port_handle(uring_port_t *port, int op, int res) {
+    port->inflight -= 1;
+    
+    switch(op) {
+    case OP_POLL:
+        if(res > 0 && (res & (POLLERR | POLLHUP | POLLNVAL)))
+            port->lost = true;
+        else if(res < 0 && res != -ECANCELED)
+            port->lost = true;
+        break;
+        
+    case OP_READ:
+        port->read_armed = false;
+        if(res > 0) {
+            port_record(port, CAPTURE_RX, port->chunk, res);
+            if(port->rx_size == 0)
+                port->rx_time = serial_now_us();
+            memcpy(port->rx + port->rx_size, port->chunk, res);
+            port->rx_size += res;
+        } else if(res == 0) {
+            // Readable, but at end of file: the other end hung up.
+            port->lost = true;
+        } else if(res != -EAGAIN && res != -ECANCELED && res != -EINTR) {
+            port->lost = true;
+        }
+        break;
+        
+    case OP_WRITE:
+        if(res > 0) {
+            port_record(port, CAPTURE_TX, port->tx, res);
+            memmove(port->tx, port->tx + res, port->tx_size - res);
+            port->tx_size -= res;
+        } else if(res != -EAGAIN && res != -ECANCELED && res != -EINTR) {
+            port->lost = true;
+        }
+        port->write_len = 0;
+        break;
+    }
+}
+
+static void free_port(uring_port_t *port) {
+    free(port->rx);
+    free(port->tx);
+    free(port);
+}
+
+static void release_orphan(serial_uring_t *ring, uring_port_t *port) {
+    for(uring_port_t **it = &ring->orphans; *it != NULL; it = &(*it)->next_orphan) {
+        if(*it != port)
+            continue;
+        *it = port->next_orphan;
+        free_port(port);
+        return;
+    }
+}
+
+// Completions are in shared memory: reaping them doesn't need a syscall.
+static void ring_reap(serial_uring_t *ring) {
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    
+    while(head != tail) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        head += 1;
+        if(cqe->user_data == 0)
+            continue;
+        uring_port_t *port = (uring_port_t *)(uintptr_t)(cqe->user_data & ~(uint64_t)OP_MASK);
+        port_handle(port, (int)(cqe->user_data & OP_MASK), cqe->res);
+        if(port->orphaned && port->inflight == 0)
+            release_orphan(ring, port);
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static uint64_t port_tag(uring_port_t *port, int op) {
+    return (uint64_t)(uintptr_t)port | (uint64_t)op;
+}
+
+static void port_arm(serial_uring_t *ring, uring_port_t *port) {
+    if(port->lost || port->closing)
+        return;
+    
+    // Keep a read outstanding: a poll linked to a read, so the read only runs once data is in.
+    if(!port->read_armed && URING_RX_CAP - port->rx_size >= URING_READ_CHUNK) {
+        struct io_uring_sqe *poll = ring_get_sqes(ring, 2);
+        if(poll != NULL) {
+            poll->opcode = IORING_OP_POLL_ADD;
+            poll->fd = port->fd;
+            poll->poll32_events = POLLIN;
+            poll->flags = IOSQE_IO_LINK;
+            poll->user_data = port_tag(port, OP_POLL);
+            
+            struct io_uring_sqe *read = ring_next_sqe(ring, poll);
+            read->opcode = IORING_OP_READ;
+            read->fd = port->fd;
+            read->addr = (uint64_t)(uintptr_t)port->chunk;
+            read->len = URING_READ_CHUNK;
+            read->off = (uint64_t)-1;
+            read->user_data = port_tag(port, OP_READ);
+            
+            port->read_armed = true;
+            port->inflight += 2;
+        }
+    }
+    
+    if(port->write_len == 0 && port->tx_size > 0) {
+        struct io_uring_sqe *write = ring_get_sqes(ring, 1);
+        if(write != NULL) {
+            write->opcode = IORING_OP_WRITE;
+            write->fd = port->fd;
+            write->addr = (uint64_t)(uintptr_t)port->tx;
+            write->len = port->tx_size;
+            write->off = (uint64_t)-1;
+            write->user_data = port_tag(port, OP_WRITE);
+            
+            port->write_len = port->tx_size;
+            port->inflight += 1;
+        }
+    }
+}
+
+// MARK: - Public API
+
+serial_uring_t *serial_uring_new(int max_ports) {
+    unsigned entries = 64;
+    while(entries < (unsigned)max_ports * 4)
+        entries <<= 1;
+    
+    serial_uring_t *ring = calloc(1, sizeof(*ring));
+    if(ring == NULL)
+        return NULL;
+    
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    SERIAL_SYSCALL();
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if(ring->fd < 0) {
+        free(ring);
+        return NULL;
+    }
+    if(!(params.features & IORING_FEAT_EXT_ARG))
+        goto errout;
+    
+    ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP) {
+        if(ring->cq_map_size > ring->sq_map_size)
+            ring->sq_map_size = ring->cq_map_size;
+        ring->cq_map_size = 0;
+    }
+    
+    ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if(ring->sq_map == MAP_FAILED)
+        goto errout;
+    
+    ring->cq_map = ring->sq_map;
+    if(ring->cq_map_size > 0) {
+        ring->cq_map = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if(ring->cq_map == MAP_FAILED)
+            goto errout;
+    }
+    
+    ring->sqe_map_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqe_map = mmap(NULL, ring->sqe_map_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if(ring->sqe_map == MAP_FAILED)
+        goto errout;
+    
+    char *sq = ring->sq_map;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->sq_entries = params.sq_entries;
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->sqes = ring->sqe_map;
+    
+    char *cq = ring->cq_map;
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    
+    ring->port_cap = max_ports;
+    ring->ports = calloc(max_ports, sizeof(*ring->ports));
+    if(ring->ports == NULL)
+        goto errout;
+    return ring;
+    
+errout:
+    if(ring->sqe_map != NULL && ring->sqe_map != MAP_FAILED)
+        munmap(ring->sqe_map, ring->sqe_map_size);
+    if(ring->cq_map_size > 0 && ring->cq_map != NULL && ring->cq_map != MAP_FAILED)
+        munmap(ring->cq_map, ring->cq_map_size);
+    if(ring->sq_map != NULL && ring->sq_map != MAP_FAILED)
+        munmap(ring->sq_map, ring->sq_map_size);
+    close(ring->fd);
+    free(ring);
+    return NULL;
+}
+
+void serial_uring_destroy(serial_uring_t *ring) {
+    if(ring == NULL)
+        return;
+    while(ring->port_count > 0)
+        serial_uring_remove(ring, ring->ports[0]->serial);
+    
+    munmap(ring->sqe_map, ring->sqe_map_size);
+    if(ring->cq_map_size > 0)
+        munmap(ring->cq_map, ring->cq_map_size);
+    munmap(ring->sq_map, ring->sq_map_size);
+    // Tearing the ring down cancels whatever the orphans were still waiting on.
+    close(ring->fd);
+    while(ring->orphans != NULL) {
+        uring_port_t *port = ring->orphans;
+        ring->orphans = port->next_orphan;
+        free_port(port);
+    }
+    free(ring->ports);
+    free(ring);
+}
+
+bool serial_uring_add(serial_uring_t *ring, serial_t *serial) {
+    if(ring == NULL || serial == NULL)
+        return false;
+    if(serial->backend != NULL) {
+        return serial->backend == &uring_backend
+            && ((uring_port_t *)serial->backend_data)->ring == ring;
+    }
+    if(ring->port_count >= ring->port_cap)
+        return false;
+    
+    uring_port_t *port = calloc(1, sizeof(*port));
+    if(port == NULL)
+        return false;
+    port->rx = malloc(URING_RX_CAP);
+    port->tx = malloc(URING_TX_CAP);
+    if(port->rx == NULL || port->tx == NULL) {
+        free(port->rx);
+        free(port->tx);
+        free(port);
+        return false;
+    }
+    port->ring = ring;
+    port->serial = serial;
+    port->fd = serial->fd;
+    
+    ring->ports[ring->port_count++] = port;
+    serial->backend = &uring_backend;
+    serial->backend_data = port;
+    return true;
+}
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Cancels everything the port has in flight: the armed poll and read, and any write, which could
+// otherwise sit forever on a wedged tty. Returns false if the submission queue stayed full.
+static bool cancel_port(serial_uring_t *ring, uring_port_t *port, uint64_t deadline) {
+    static const int ops[] = {OP_POLL, OP_READ, OP_WRITE};
+    const int count = sizeof(ops) / sizeof(*ops);
+    
+    struct io_uring_sqe *cancel = ring_get_sqes(ring, count);
+    while(cancel == NULL) {
+        // ring_get_sqes() already tried to submit, so the kernel is behind on the queue.
+        ring_reap(ring);
+        if(now_ms() >= deadline)
+            return false;
+        ring_wait(ring, 1);
+        ring_reap(ring);
+        cancel = ring_get_sqes(ring, count);
+    }
+    for(int i = 0; i < count; ++i) {
+        cancel->opcode = IORING_OP_ASYNC_CANCEL;
+        cancel->addr = port_tag(port, ops[i]);
+        cancel = ring_next_sqe(ring, cancel);
+    }
+    return true;
+}
+
+// Runs on the caller's thread during disconnect, so it never waits more than URING_CANCEL_MS. A port
+// that is still busy past that is left to the ring as an orphan, and freed once its requests complete.
+void serial_uring_remove(serial_uring_t *ring, serial_t *serial) {
+    if(ring == NULL || serial == NULL || serial->backend != &uring_backend)
+        return;
+    uring_port_t *port = serial->backend_data;
+    if(port->ring != ring)
+        return;
+    
+    // Outstanding requests point into the port, so they must all complete before we free it.
+    port->closing = true;
+    uint64_t deadline = now_ms() + URING_CANCEL_MS;
+    ring_reap(ring);
+    if(port->inflight > 0 && cancel_port(ring, port, deadline)) {
+        while(port->inflight > 0) {
+            uint64_t now = now_ms();
+            if(now >= deadline || !ring_wait(ring, (int)(deadline - now)))
+                break;
+            ring_reap(ring);
+        }
+    }
+    
+    // Best effort: don't drop output that was queued just before the port was handed back.
+    if(!port->lost && port->inflight == 0 && port->tx_size > 0) {
+        SERIAL_SYSCALL();
+        ssize_t rc = write(port->fd, port->tx, port->tx_size);
+        if(rc > 0)
+            port_record(port, CAPTURE_TX, port->tx, (int)rc);
+    }
+    
+    for(int i = 0; i < ring->port_count; ++i) {
+        if(ring->ports[i] != port)
+            continue;
+        memmove(&ring->ports[i], &ring->ports[i + 1],
+                (ring->port_count - i - 1) * sizeof(*ring->ports));
+        ring->port_count -= 1;
+        break;
+    }
+    
+    serial->backend = NULL;
+    serial->backend_data = NULL;
+    port->serial = NULL;
+    if(port->inflight > 0) {
+        port->orphaned = true;
+        port->next_orphan = ring->orphans;
+        ring->orphans = port;
+        return;
+    }
+    free_port(port);
+}
+
+int serial_uring_flush(serial_uring_t *ring) {
+    if(ring == NULL)
+        return -1;
+    ring_reap(ring);
+    for(int i = 0; i < ring->port_count; ++i)
+        port_arm(ring, ring->ports[i]);
+    if(ring_submit(ring, 0) < 0)
+        return -1;
+    ring_reap(ring);
+    return 0;
+}
+
+// MARK: - Port I/O (called from serial.c)
+
+static void uring_port_detach(serial_t *serial) {
+    uring_port_t *port = serial->backend_data;
+    serial_uring_remove(port->ring, serial);
+}
+
+static int uring_port_read(serial_t *serial, char *buffer, int cap) {
+    uring_port_t *port = serial->backend_data;
+    ring_reap(port->ring);
+    
+    int len = port->rx_size < cap ? port->rx_size : cap;
+    memcpy(buffer, port->rx, len);
+    memmove(port->rx, port->rx + len, port->rx_size - len);
+    port->rx_size -= len;
+    serial->rx_time = port->rx_time;
+    if(len == 0 && port->lost)
+        return -1;
+    return len;
+}
+
+static int uring_port_write(serial_t *serial, const char *buffer, int num) {
+    uring_port_t *port = serial->backend_data;
+    if(port->lost)
+        return -1;
+    // Appending never touches the bytes owned by an in-flight write, which sit at the front.
+    int len = URING_TX_CAP - port->tx_size;
+    if(len > num)
+        len = num;
+    memcpy(port->tx + port->tx_size, buffer, len);
+    port->tx_size += len;
+    return len;
+}
+
+static int uring_port_poll(serial_t *serial, int timeout_ms) {
+    uring_port_t *port = serial->backend_data;
+    serial_uring_t *ring = port->ring;
+    
+    ring_reap(ring);
+    if(port->rx_size == 0 && !port->lost && timeout_ms > 0) {
+        serial_uring_flush(ring);
+        
+        // Completions for other ports (or our own writes) wake us up too, so each wait only gets
+        // what's left of the caller's timeout.
+        uint64_t deadline = now_ms() + (uint64_t)timeout_ms;
+        while(port->rx_size == 0 && !port->lost) {
+            uint64_t now = now_ms();
+            if(now >= deadline)
+                break;
+            bool ok = ring_wait(ring, (int)(deadline - now));
+            ring_reap(ring);
+            if(!ok)
+                break;
+            // Whatever completed might have been for another port: re-arm ours and wait again.
+            port_arm(ring, port);
+            ring_submit(ring, 0);
+        }
+    }
+    if(port->rx_size > 0)
+        return 1;
+    return port->lost ? -1 : 0;
+}
+
+#else
+
+serial_uring_t *serial_uring_new(int max_ports) {
+    (void)max_ports;
+    return NULL;
+}
+
+void serial_uring_destroy(serial_uring_t *ring) {
+    (void)ring;
+}
+
+bool serial_uring_add(serial_uring_t *ring, serial_t *serial) {
+    (void)ring;
+    (void)serial;
+    return false;
+}
+
+void serial_uring_remove(serial_uring_t *ring, serial_t *serial) {
+    (void)ring;
+    (void)serial;
+}
+
+int serial_uring_flush(serial_uring_t *ring) {
+    (void)ring;
+    return -1;
+}
+
+#endif
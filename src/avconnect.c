@@ -23,14 +23,65 @@ static float avconnect_floop(float elapsed, float last_floop, int counter, void
 void do_read_conf(char *path);
 
 
+#define MAX_URING_PORTS (64)
+
+typedef enum {
+    IO_BACKEND_POLL,
+    IO_BACKEND_EPOLL,
+    IO_BACKEND_URING,
+} io_backend_t;
+
+static const char *io_backend_str[] = {
+    [IO_BACKEND_POLL]   = "poll",
+    [IO_BACKEND_EPOLL]  = "epoll",
+    [IO_BACKEND_URING]  = "io_uring",
+};
+
 static device_buf_t     devices = {};
+static io_backend_t     io_backend = IO_BACKEND_EPOLL;
+static serial_reactor_t *reactor = NULL;
+static serial_uring_t   *uring = NULL;
+static serial_hotplug_t *hotplug = NULL;
 static bool             is_inited = false;
 
+static void attach_backend(av_device_t *dev) {
+    av_device_set_reactor(dev, reactor);
+    av_device_set_uring(dev, uring);
+}
+
+static void start_backend() {
+    switch(io_backend) {
+    case IO_BACKEND_POLL:
+        break;
+    case IO_BACKEND_EPOLL:
+        reactor = serial_reactor_new();
+        if(reactor == NULL)
+            logMsg("epoll backend unavailable, devices will be polled from the flight loop");
+        break;
+    case IO_BACKEND_URING:
+        uring = serial_uring_new(MAX_URING_PORTS);
+        if(uring == NULL)
+            logMsg("io_uring backend unavailable, devices will be polled from the flight loop");
+        break;
+    }
+}
+
+static void stop_backend() {
+    serial_reactor_destroy(reactor);
+    serial_uring_destroy(uring);
+    reactor = NULL;
+    uring = NULL;
+}
+
 void avconnect_init() {
     if(is_inited)
         return;
     
     device_buf_init(&devices);
+    start_backend();
+    hotplug = serial_hotplug_new();
+    if(hotplug == NULL)
+        logMsg("hotplug monitoring unavailable, lost devices must be reconnected manually");
     settings_init();
     XPLMRegisterFlightLoopCallback(avconnect_floop, -1, NULL);
     is_inited = true;
@@ -47,6 +98,39 @@ void avconnect_fini() {
         av_device_destroy(devices.data[i]);
     }
     device_buf_fini(&devices);
+    stop_backend();
+    serial_hotplug_destroy(hotplug);
+    hotplug = NULL;
+}
+
+bool avconnect_set_io_backend(const char *name) {
+    int backend = -1;
+    for(int i = 0; i < (int)(sizeof(io_backend_str)/sizeof(*io_backend_str)); ++i) {
+        if(strcmp(io_backend_str[i], name) == 0)
+            backend = i;
+    }
+    if(backend < 0) {
+        logMsg("unknown I/O backend `%s`", name);
+        return false;
+    }
+    if((io_backend_t)backend == io_backend)
+        return true;
+    
+    // Devices must hand their ports back before the old backend is torn down.
+    for(int i = 0; i < devices.count; ++i) {
+        av_device_set_reactor(devices.data[i], NULL);
+        av_device_set_uring(devices.data[i], NULL);
+    }
+    stop_backend();
+    io_backend = backend;
+    start_backend();
+    for(int i = 0; i < devices.count; ++i)
+        attach_backend(devices.data[i]);
+    return true;
+}
+
+const char *avconnect_get_io_backend() {
+    return io_backend_str[io_backend];
 }
 
 
@@ -82,6 +166,7 @@ void avconnect_conf_save(bool acf_specific) {
     free(path);
     
     fprintf(out, "# AvConnect configuration\n");
+    fprintf(out, "io_backend = \"%s\"\n", avconnect_get_io_backend());
     for(int i = 0; i < devices.count; ++i) {
         av_device_write(devices.data[i], out);
     }
@@ -94,6 +179,7 @@ int avconnect_get_device_count() {
 
 av_device_t *avconnect_device_add() {
     av_device_t *dev = av_device_new();
+    attach_backend(dev);
     device_buf_write(&devices, dev);
     return dev;
 }
@@ -122,9 +208,20 @@ float avconnect_floop(float elapsed, float last_floop, int counter, void *refcon
     UNUSED(counter);
     UNUSED(refcon);
     
+    serial_hotplug_event_t events[16];
+    int event_count = serial_hotplug_poll(hotplug, events, 16);
+    for(int i = 0; i < event_count; ++i) {
+        for(int j = 0; j < devices.count; ++j) {
+            av_device_on_hotplug(devices.data[j], &events[i]);
+        }
+    }
+    
     for(int i = 0; i < devices.count; ++i) {
         av_device_update(devices.data[i]);
     }
+    // Everything the devices queued this frame goes out in a single submission.
+    if(uring != NULL)
+        serial_uring_flush(uring);
     
     return -1.f;
 }
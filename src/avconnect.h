@@ -23,6 +23,9 @@ void avconnect_fini();
 void avconnect_conf_check_reload(bool acf_specific);
 void avconnect_conf_save(bool acf_specific);
 
+bool avconnect_set_io_backend(const char *name);
+const char *avconnect_get_io_backend();
+
 void avconnect_device_delete_all();
 int avconnect_get_device_count();
 av_device_t *avconnect_device_get(int i);
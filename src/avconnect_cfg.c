@@ -12,6 +12,56 @@
 #include <acfutils/helpers.h>
 
 #define CHECK(dat, err) if(!dat.ok) { logMsg(err); goto out; }
+#define COUNTOF(x) (sizeof(x)/sizeof(*x))
+
+static int find_str_in(const char **array, int n, const char *str) {
+    for(int i = 0; i < n; ++i) {
+        if(strcmp(array[i], str) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// The dataref an input writes to is optional. Returns whether the input has one.
+static bool parse_act(toml_table_t *cin, av_dref_act_t *act) {
+    toml_datum_t dref = toml_string_in(cin, "dataref");
+    if(!dref.ok)
+        return false;
+    
+    lacf_strlcpy(act->dref.path, dref.u.s, sizeof(act->dref.path));
+    act->dref.has_changed = true;
+    free(dref.u.s);
+    
+    toml_datum_t op_str = toml_string_in(cin, "dataref_op");
+    if(op_str.ok) {
+        int op = find_str_in(av_act_str, COUNTOF(av_act_str), op_str.u.s);
+        if(op < 0)
+            logMsg("invalid dataref action: %s", op_str.u.s);
+        else
+            act->op = op;
+        free(op_str.u.s);
+    }
+    
+    toml_datum_t index = toml_int_in(cin, "dataref_index");
+    toml_datum_t on = toml_double_in(cin, "on");
+    toml_datum_t off = toml_double_in(cin, "off");
+    toml_datum_t min = toml_double_in(cin, "min");
+    toml_datum_t max = toml_double_in(cin, "max");
+    toml_datum_t wrap = toml_bool_in(cin, "wrap");
+    if(index.ok)
+        act->index = index.u.i;
+    if(on.ok)
+        act->on_val = on.u.d;
+    if(off.ok)
+        act->off_val = off.u.d;
+    if(min.ok)
+        act->min = min.u.d;
+    if(max.ok)
+        act->max = max.u.d;
+    if(wrap.ok)
+        act->wrap = wrap.u.b;
+    return true;
+}
 
 static void parse_encoder(av_device_t *dev, toml_table_t *cencoder) {
     if(cencoder == NULL) {
@@ -24,15 +74,39 @@ static void parse_encoder(av_device_t *dev, toml_table_t *cencoder) {
     toml_datum_t cmd_dn = toml_string_in(cencoder, "command_down");
     
     CHECK(name, "missing encoder name");
-    CHECK(cmd_up, "missing button up command");
-    CHECK(cmd_dn, "missing button down command");
     
     av_in_encoder_t *encoder = av_device_add_in_encoder_str(dev, name.u.s);
-    lacf_strlcpy(encoder->cmd_dn.path, cmd_dn.u.s, sizeof(encoder->cmd_dn.path));
-    lacf_strlcpy(encoder->cmd_up.path, cmd_up.u.s, sizeof(encoder->cmd_up.path));
+    bool has_act = parse_act(cencoder, &encoder->act);
+    // Encoders only have steps to give, not an on/off state.
+    if(has_act && encoder->act.op != AV_ACT_INCR) {
+        logMsg("encoder %s: dataref_op must be incr", name.u.s);
+        encoder->act.op = AV_ACT_INCR;
+    }
+    if(!has_act) {
+        CHECK(cmd_up, "missing button up command");
+        CHECK(cmd_dn, "missing button down command");
+    }
+    if(cmd_dn.ok)
+        lacf_strlcpy(encoder->cmd_dn.path, cmd_dn.u.s, sizeof(encoder->cmd_dn.path));
+    if(cmd_up.ok)
+        lacf_strlcpy(encoder->cmd_up.path, cmd_up.u.s, sizeof(encoder->cmd_up.path));
     
     encoder->cmd_dn.has_changed = true;
     encoder->cmd_up.has_changed = true;
+    
+    // Older configs don't have these, the defaults send one command per detent.
+    toml_datum_t fast_steps = toml_int_in(cencoder, "fast_steps");
+    toml_datum_t accel_ms = toml_int_in(cencoder, "accel_ms");
+    toml_datum_t accel_max = toml_double_in(cencoder, "accel_max");
+    toml_datum_t max_per_frame = toml_int_in(cencoder, "max_per_frame");
+    if(fast_steps.ok)
+        encoder->fast_steps = fast_steps.u.i;
+    if(accel_ms.ok)
+        encoder->accel_ms = accel_ms.u.i;
+    if(accel_max.ok)
+        encoder->accel_max = accel_max.u.d;
+    if(max_per_frame.ok)
+        encoder->max_per_frame = max_per_frame.u.i;
 out:
     if(name.ok) free(name.u.s);
     if(cmd_up.ok) free(cmd_up.u.s);
@@ -49,10 +123,12 @@ static void parse_button(av_device_t *dev, toml_table_t *cbutton) {
     toml_datum_t cmd = toml_string_in(cbutton, "command");
     
     CHECK(name, "missing button name");
-    CHECK(cmd, "missing button command");
     
     av_in_button_t *button = av_device_add_in_button_str(dev, name.u.s);
-    lacf_strlcpy(button->cmd.path, cmd.u.s, sizeof(button->cmd.path));
+    if(!parse_act(cbutton, &button->act))
+        CHECK(cmd, "missing button command");
+    if(cmd.ok)
+        lacf_strlcpy(button->cmd.path, cmd.u.s, sizeof(button->cmd.path));
     
     button->cmd.has_changed = true;
 out:
@@ -72,7 +148,6 @@ static void parse_mux(av_device_t *dev, toml_table_t *cmux) {
     
     CHECK(name, "missing mulitplexer name");
     CHECK(pin, "missing multiplexer input");
-    CHECK(cmd, "missing multiplexer command");
     
     
     int p = pin.u.i;
@@ -82,8 +157,10 @@ static void parse_mux(av_device_t *dev, toml_table_t *cmux) {
     }
     
     av_in_mux_t *mux = av_device_add_in_mux_str(dev, name.u.s);
-    
-    lacf_strlcpy(mux->cmd[p].path, cmd.u.s, sizeof(mux->cmd[p].path));
+    if(!parse_act(cmux, &mux->act[p]))
+        CHECK(cmd, "missing multiplexer command");
+    if(cmd.ok)
+        lacf_strlcpy(mux->cmd[p].path, cmd.u.s, sizeof(mux->cmd[p].path));
     mux->cmd[p].has_changed = true;
     
 out:
@@ -91,14 +168,70 @@ out:
     if(cmd.ok) free(cmd.u.s);
 }
 
-#define COUNTOF(x) (sizeof(x)/sizeof(*x))
+static void parse_shifter(av_device_t *dev, toml_table_t *cshifter) {
+    if(cshifter == NULL) {
+        logMsg("input shifter mapping must be a table");
+        return;
+    }
+    
+    toml_datum_t name = toml_string_in(cshifter, "name");
+    toml_datum_t pin = toml_int_in(cshifter, "input");
+    toml_datum_t cmd = toml_string_in(cshifter, "command");
+    
+    CHECK(name, "missing input shifter name");
+    CHECK(pin, "missing input shifter input");
+    CHECK(cmd, "missing input shifter command");
+    
+    int p = pin.u.i;
+    if(p < 0 || p >= AV_SHIFTER_MAX_PINS) {
+        logMsg("Only %d inputs allowed per input shifter", AV_SHIFTER_MAX_PINS);
+        goto out;
+    }
+    
+    av_in_shifter_t *shifter = av_device_add_in_shifter_str(dev, name.u.s);
+    // Chains are made of 8-input modules.
+    if(p >= shifter->pins)
+        shifter->pins = (p / 8 + 1) * 8;
+    
+    lacf_strlcpy(shifter->cmd[p].path, cmd.u.s, sizeof(shifter->cmd[p].path));
+    shifter->cmd[p].has_changed = true;
+    
+out:
+    if(name.ok) free(name.u.s);
+    if(cmd.ok) free(cmd.u.s);
+}
 
-static int find_str_in(const char **array, int n, const char *str) {
-    for(int i = 0; i < n; ++i) {
-        if(strcmp(array[i], str) == 0)
-            return i;
+static void parse_analog(av_device_t *dev, toml_table_t *canalog) {
+    if(canalog == NULL) {
+        logMsg("analog mapping must be a table");
+        return;
     }
-    return -1;
+    
+    toml_datum_t name = toml_string_in(canalog, "name");
+    toml_datum_t dref = toml_string_in(canalog, "dataref");
+    
+    CHECK(name, "missing analog name");
+    CHECK(dref, "missing analog dataref");
+    
+    av_in_analog_t *analog = av_device_add_in_analog_str(dev, name.u.s);
+    lacf_strlcpy(analog->dref.path, dref.u.s, sizeof(analog->dref.path));
+    analog->dref.has_changed = true;
+    
+    toml_datum_t min = toml_double_in(canalog, "min");
+    toml_datum_t max = toml_double_in(canalog, "max");
+    toml_datum_t deadband = toml_int_in(canalog, "deadband");
+    toml_datum_t smoothing = toml_double_in(canalog, "smoothing");
+    if(min.ok)
+        analog->min = min.u.d;
+    if(max.ok)
+        analog->max = max.u.d;
+    if(deadband.ok)
+        analog->deadband = deadband.u.i;
+    if(smoothing.ok)
+        analog->smoothing = smoothing.u.d;
+out:
+    if(name.ok) free(name.u.s);
+    if(dref.ok) free(dref.u.s);
 }
 
 static void parse_pwm(av_device_t *dev, toml_table_t *cpwm) {
@@ -203,6 +336,12 @@ void do_read_conf(char *path) {
     
     avconnect_device_delete_all();
     
+    toml_datum_t io_backend = toml_string_in(conf, "io_backend");
+    if(io_backend.ok) {
+        avconnect_set_io_backend(io_backend.u.s);
+        free(io_backend.u.s);
+    }
+    
     int dev_count = toml_array_nelem(devices);
     
     for(int i = 0; i < dev_count; ++i) {
@@ -217,6 +356,14 @@ void do_read_conf(char *path) {
         }
         
         av_device_t *dev = avconnect_device_add();
+        toml_datum_t threaded = toml_bool_in(cdev, "threaded");
+        if(threaded.ok)
+            av_device_set_threaded(dev, threaded.u.b);
+        toml_datum_t capture = toml_string_in(cdev, "capture");
+        if(capture.ok) {
+            av_device_set_capture(dev, capture.u.s);
+            free(capture.u.s);
+        }
         av_device_set_address(dev, address.u.s);
         
         toml_array_t *encoders = toml_array_in(cdev, "in_encoders");
@@ -237,6 +384,18 @@ void do_read_conf(char *path) {
                 parse_mux(dev, toml_table_at(muxes, i));
         }
         
+        toml_array_t *shifters = toml_array_in(cdev, "in_shifters");
+        if(shifters) {
+            for(int i = 0; i < toml_array_nelem(shifters); ++i)
+                parse_shifter(dev, toml_table_at(shifters, i));
+        }
+        
+        toml_array_t *analogs = toml_array_in(cdev, "in_analogs");
+        if(analogs) {
+            for(int i = 0; i < toml_array_nelem(analogs); ++i)
+                parse_analog(dev, toml_table_at(analogs, i));
+        }
+        
         toml_array_t *pwms = toml_array_in(cdev, "out_pwms");
         if(pwms) {
             for(int i = 0; i < toml_array_nelem(pwms); ++i)
@@ -0,0 +1,213 @@
+/*===--------------------------------------------------------------------------------------------===
+ * cmd_bench.c - command encoding and decoding throughput
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent. All rights reserved
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cmd_ids.h"
+#include "utils/cmd_enc.h"
+#include "utils/cmd_dec.h"
+#include "utils/scan.h"
+
+#define MIN_BENCH_TIME  (0.2)
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// A burst of mux changes, the worst case we get from a real board (a whole input bank flipping).
+static char *make_burst(int events, int *len) {
+    char *burst = malloc(events * 32);
+    int size = 0;
+    for(int i = 0; i < events; ++i)
+        size += sprintf(burst + size, "%d,Mux%d,%d,%d;\r\n", kDigInMuxChange, i % 4, i % 16, i & 1);
+    *len = size;
+    return burst;
+}
+
+// One kInfo reply carrying a board configuration, which is what a fully populated Mega sends back
+// to kGetConfig.
+static char *make_config(int items, int *len) {
+    char *config = malloc(items * 48 + 32);
+    int size = sprintf(config, "%d,", kInfo);
+    for(int i = 0; i < items; ++i)
+        size += sprintf(config + size, "1.%d.Button%d:8.%d.%d.0.Encoder%d:", i % 54, i, i % 54, (i + 1) % 54, i);
+    size += sprintf(config + size, ";\r\n");
+    *len = size;
+    return config;
+}
+
+static int decode_all(cmd_dec_t *dec) {
+    char name[64];
+    int count = 0;
+    cmd_msg_t msg;
+    while(cmd_dec_next_cmd(dec, &msg)) {
+        cmd_msg_str(&msg, 0, name, sizeof(name));
+        cmd_msg_int(&msg, 1);
+        cmd_msg_int(&msg, 2);
+        count += 1;
+    }
+    return count;
+}
+
+// MARK: - Decoding
+
+// Feeds `data` in `chunk`-byte reads (all at once if `chunk` is 0), decoding after each one like
+// av_device_update does.
+static void run(const char *label, const char *data, int len, int events, int chunk) {
+    cmd_dec_t dec;
+    cmd_dec_init(&dec);
+
+    long iterations = 0;
+    long decoded = 0;
+    double start = now(), elapsed = 0;
+    do {
+        int step = chunk > 0 ? chunk : len;
+        for(int off = 0; off < len; off += step) {
+            int size = len - off < step ? len - off : step;
+            for(int taken = 0; taken < size;) {
+                taken += cmd_dec_process_input(&dec, data + off + taken, size - taken);
+                decoded += decode_all(&dec);
+            }
+        }
+        iterations += 1;
+        elapsed = now() - start;
+    } while(elapsed < MIN_BENCH_TIME);
+
+    if(decoded != (long)events * iterations)
+        fprintf(stderr, "warning: decoded %ld commands, expected %ld\n", decoded, (long)events * iterations);
+
+    double bytes = (double)len * iterations;
+    printf("%-8s %-10s %6d bytes  chunk %4d: %9.1f ns/cmd %8.1f MB/s\n",
+           scan_impl_str(scan_get_impl()), label, len, chunk, elapsed * 1e9 / decoded, bytes / elapsed / 1e6);
+
+    cmd_dec_fini(&dec);
+}
+
+static void run_bursts(int chunk) {
+    static const int bursts[] = {8, 128, 2048};
+    for(size_t i = 0; i < sizeof(bursts)/sizeof(*bursts); ++i) {
+        int len = 0;
+        char *burst = make_burst(bursts[i], &len);
+        char label[32];
+        snprintf(label, sizeof(label), "mux x%d", bursts[i]);
+        run(label, burst, len, bursts[i], chunk);
+        free(burst);
+    }
+}
+
+static void run_config(int items) {
+    int len = 0;
+    char *config = make_config(items, &len);
+    char label[32];
+    snprintf(label, sizeof(label), "config x%d", items);
+    run(label, config, len, 1, 0);
+    free(config);
+}
+
+// MARK: - Encoding
+
+#define ENCODE_BATCH    (256)
+
+// What cmd_enc_send_* used to do: one printf per argument.
+static void encode_printf(cmd_enc_t *enc, int i) {
+    str_buf_printf_back(&enc->buf, "%d", kSetPin);
+    str_buf_printf_back(&enc->buf, ",%d", i % 54);
+    str_buf_printf_back(&enc->buf, ",%d", i & 0xff);
+    str_buf_push_back(&enc->buf, ";\r\n", 3);
+    
+    str_buf_printf_back(&enc->buf, "%d", kSetShiftRegisterPins);
+    str_buf_printf_back(&enc->buf, ",%d", i % 4);
+    str_buf_printf_back(&enc->buf, ",%d|%d|%d", i % 16, (i + 5) % 16, (i + 9) % 16);
+    str_buf_printf_back(&enc->buf, ",%d", i & 1);
+    str_buf_push_back(&enc->buf, ";\r\n", 3);
+}
+
+static void encode_send(cmd_enc_t *enc, int i) {
+    cmd_enc_send_cmd_start(enc, kSetPin);
+    cmd_enc_send_arg_int(enc, i % 54);
+    cmd_enc_send_arg_int(enc, i & 0xff);
+    cmd_enc_send_cmd_commit(enc);
+    
+    char pins[32];
+    snprintf(pins, sizeof(pins), "%d|%d|%d", i % 16, (i + 5) % 16, (i + 9) % 16);
+    cmd_enc_send_cmd_start(enc, kSetShiftRegisterPins);
+    cmd_enc_send_arg_int(enc, i % 4);
+    cmd_enc_send_arg_cstr(enc, pins);
+    cmd_enc_send_arg_int(enc, i & 1);
+    cmd_enc_send_cmd_commit(enc);
+}
+
+static const cmd_tpl_t set_pin_tpl = CMD_TPL(kSetPin, 2, CMD_TPL_NO_LIST);
+static const cmd_tpl_t set_sreg_tpl = CMD_TPL(kSetShiftRegisterPins, 3, 1);
+
+static void encode_tpl(cmd_enc_t *enc, int i) {
+    int16_t pin_args[] = {i % 54, i & 0xff};
+    cmd_enc_send_tpl(enc, &set_pin_tpl, pin_args, NULL, 0);
+    
+    int16_t sreg_args[] = {i % 4, i & 1};
+    int16_t pins[] = {i % 16, (i + 5) % 16, (i + 9) % 16};
+    cmd_enc_send_tpl(enc, &set_sreg_tpl, sreg_args, pins, 3);
+}
+
+static void run_encode(const char *label, void (*encode)(cmd_enc_t *, int)) {
+    cmd_enc_t enc;
+    cmd_enc_init(&enc);
+    
+    long commands = 0;
+    long bytes = 0;
+    double start = now(), elapsed = 0;
+    do {
+        for(int i = 0; i < ENCODE_BATCH; ++i)
+            encode(&enc, i);
+        commands += ENCODE_BATCH * 2;
+        int len = 0;
+        cmd_enc_peek_output(&enc, &len);
+        bytes += len;
+        cmd_enc_consume_output(&enc, len);
+        elapsed = now() - start;
+    } while(elapsed < MIN_BENCH_TIME);
+    
+    printf("encode   %-10s %13ld bytes            : %9.1f ns/cmd %8.1f MB/s\n",
+           label, bytes, elapsed * 1e9 / commands, bytes / elapsed / 1e6);
+    cmd_enc_fini(&enc);
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+
+    static const scan_impl_t impls[] = {SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2};
+    for(size_t i = 0; i < sizeof(impls)/sizeof(*impls); ++i) {
+        if(!scan_set_impl(impls[i]))
+            continue;
+        run_bursts(0);
+        run_config(16);
+        run_config(64);
+    }
+    scan_set_impl(SCAN_AUTO);
+    
+    run_bursts(512);
+    // Commands split across many small reads, as they are at low baud rates.
+    static const int chunks[] = {1, 4, 16, 64};
+    for(size_t i = 0; i < sizeof(chunks)/sizeof(*chunks); ++i) {
+        int len = 0;
+        char *burst = make_burst(512, &len);
+        run("mux x512", burst, len, 512, chunks[i]);
+        free(burst);
+    }
+    
+    run_encode("printf", encode_printf);
+    run_encode("send", encode_send);
+    run_encode("template", encode_tpl);
+    return 0;
+}
@@ -12,18 +12,26 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <XPLMUtilities.h>
+#include "outputs.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
     
 #define AV_MUX_MAX_PINS    (16)
+#define AV_IN_NAME_MAX     (32)
+#define AV_ANALOG_MAX      (1023)
+#define AV_SHIFTER_MAX_PINS (128)
+#define AV_SHIFTER_WORDS   (AV_SHIFTER_MAX_PINS / 64)
     
 typedef enum {
     AV_IN_ENCODER,
     AV_IN_BUTTON,
     AV_IN_MUX,
+    AV_IN_ANALOG,
+    AV_IN_SHIFTER,
 } av_in_type_t;
 
 typedef struct {
@@ -35,27 +43,112 @@ typedef struct {
 } av_cmd_t;
 
 
+typedef enum {
+    AV_ACT_SET,
+    AV_ACT_TOGGLE,
+    AV_ACT_INCR,
+} av_act_op_t;
+
+static const char *av_act_str[] = {
+    [AV_ACT_SET]    = "set",
+    [AV_ACT_TOGGLE] = "toggle",
+    [AV_ACT_INCR]   = "incr",
+};
+
+// Writes a dataref directly, instead of going through a command. Switches `set` it to `on_val` or
+// `off_val`, `toggle` it between the two on every press, or `incr` it by `on_val` on every press
+// (encoders, by `on_val` per detent), clamped to `min`..`max` or wrapped around. `index` picks an
+// element of an array dataref, -1 for a plain one.
+//
+// Events only add up into `pending_*`; the dataref is read and written at most once a frame.
+typedef struct {
+    av_dref_t       dref;
+    int             index;
+    av_act_op_t     op;
+    float           on_val;
+    float           off_val;
+    float           min;
+    float           max;
+    bool            wrap;
+    
+    int             pending_count;  // Presses (toggle, incr) or detents (incr)
+    int             pending_set;    // -1, or the last switch position (set)
+} av_dref_act_t;
+
 typedef struct {
     av_in_type_t    type;
-    char            name[32];
+    char            name[AV_IN_NAME_MAX];
 } av_in_t;
 
+// Detents are added up over a frame, and only the net count is sent. When `max_per_frame` is set,
+// at most that many commands go out per frame and the rest are dropped (0, the default, never
+// drops detents). Fast detents count for `fast_steps`. When detents come in less than `accel_ms`
+// apart on average, the count is scaled by up to `accel_max`, growing linearly as the interval
+// shrinks.
 typedef struct {
     av_in_t         base;
     av_cmd_t        cmd_up;
     av_cmd_t        cmd_dn;
+    av_dref_act_t   act;
+    
+    int             fast_steps;
+    int             accel_ms;
+    float           accel_max;
+    int             max_per_frame;
+    
+    int             pending;
+    int             detents;
+    float           carry;
+    uint64_t        frame_time;
+    uint64_t        last_time;
 } av_in_encoder_t;
 
+// While a device syncs its switches after connecting, events only record the latest state, in
+// `sync_*`, which is applied once the board is done reporting.
 typedef struct {
     av_in_t         base;
     av_cmd_t        cmd;
+    av_dref_act_t   act;
+    int             sync_value;     // -1 if not reported
 } av_in_button_t;
 
 typedef struct {
     av_in_t         base;
     av_cmd_t        cmd[AV_MUX_MAX_PINS];
+    av_dref_act_t   act[AV_MUX_MAX_PINS];
+    uint16_t        sync_mask;      // Pins reported
+    uint16_t        sync_value;
 } av_in_mux_t;
 
+// Potentiometers. Readings within `deadband` of the last one kept are ignored. The dataref follows
+// the reading through an exponential filter, moving `1 - smoothing` of the way there every frame,
+// and 0 to AV_ANALOG_MAX maps linearly to `min` to `max`.
+typedef struct {
+    av_in_t         base;
+    av_dref_t       dref;
+    float           min;
+    float           max;
+    int             deadband;
+    float           smoothing;
+    
+    int             raw;        // -1 until the first reading
+    float           value;
+    float           last_out;
+} av_in_analog_t;
+
+// Input shift register chains (74HC165), `pins` inputs long. Events only update `next`; once a
+// frame it is compared with `state` a word at a time, and only the pins that changed send their
+// command. Pins that changed and changed back within the frame are in `pulse`.
+typedef struct {
+    av_in_t         base;
+    int             pins;
+    av_cmd_t        cmd[AV_SHIFTER_MAX_PINS];
+    
+    uint64_t        state[AV_SHIFTER_WORDS];
+    uint64_t        next[AV_SHIFTER_WORDS];
+    uint64_t        pulse[AV_SHIFTER_WORDS];
+} av_in_shifter_t;
+
 
 static inline void av_cmd_init(av_cmd_t *cmd) {
     cmd->path[0] = '\0';
@@ -96,6 +189,19 @@ static inline void av_cmd_fini(av_cmd_t *cmd) {
     av_cmd_init(cmd);
 }
 
+static inline void av_dref_act_init(av_dref_act_t *act) {
+    av_dref_init(&act->dref);
+    act->index = -1;
+    act->op = AV_ACT_SET;
+    act->on_val = 1;
+    act->off_val = 0;
+    act->min = 0;
+    act->max = 1;
+    act->wrap = false;
+    act->pending_count = 0;
+    act->pending_set = -1;
+}
+
 #ifdef __cplusplus
 }
 #endif
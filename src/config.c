@@ -9,12 +9,17 @@
 */
 #include <stdint.h>
 #include "device_impl.h"
+#include "utils/scan.h"
 #include <ctype.h>
 
+// Config items are `type.param.param...:`
+static const scan_set_t param_delims = {{':', '.', ':', ':'}, 2};
+static const scan_set_t cmd_delims = {{':', ':', ':', ':'}, 1};
 
 typedef struct {
     char        *str;
     char        *cmd_end;
+    char        *end;
 } parser_t;
 
 typedef struct {
@@ -23,45 +28,34 @@ typedef struct {
     bool is_last;
 } token_t;
 
-static char *skip_white_space(char *str) {
+static char *skip_white_space(char *str, const char *end) {
     if(str == NULL)
         return NULL;
-    while(isspace(*str))
+    while(str < end && isspace(*str))
         str += 1;
-    return *str != '\0' ? str : NULL;
+    return str < end ? str : NULL;
 }
 
-static char *get_param_end(char *str) {
+static char *get_param_end(char *str, const char *end) {
     if(str == NULL)
         return NULL;
-    while(true) {
-        if(*str == '\0' || *str == ':' || *str == '.')
-            return str;
-        str += 1;
-    }
-    return NULL;
+    return (char *)scan_find(str, end, &param_delims);
 }
 
-static char *get_cmd_end(char *str) {
-    if(str == NULL)
+static char *get_cmd_end(char *str, const char *end) {
+    if(str == NULL || str >= end)
         return NULL;
-    while(true) {
-        if(*str == '\0')
-            return NULL;
-        if(*str == ':')
-            break;
-        str += 1;
-    }
-    return str;
+    char *cmd_end = (char *)scan_find(str, end, &cmd_delims);
+    return cmd_end < end ? cmd_end : NULL;
 }
 
-static bool get_next_token(char *str, const char *cmd_end, token_t *tok) {
+static bool get_next_token(char *str, const char *str_end, const char *cmd_end, token_t *tok) {
     if(str == NULL || cmd_end == NULL)
         return false;
-    char *start = skip_white_space(str);
+    char *start = skip_white_space(str, str_end);
     if(start == NULL)
         return false;
-    char *end = get_param_end(start);
+    char *end = get_param_end(start, str_end);
     
     if(end == NULL || end == start)
         return false;
@@ -76,7 +70,7 @@ static const char *parser_get_param_str(parser_t *parser) {
     token_t tok;
     char *str = parser->str;
     const char *end = parser->cmd_end;
-    if(!get_next_token(str, end, &tok))
+    if(!get_next_token(str, parser->end, end, &tok))
         return NULL;
     
     *tok.end = '\0';
@@ -88,7 +82,7 @@ static int32_t parser_get_param_int(parser_t *parser) {
     token_t tok;
     char *str = parser->str;
     const char *end = parser->cmd_end;
-    if(!get_next_token(str, end, &tok))
+    if(!get_next_token(str, parser->end, end, &tok))
         return INT32_MAX;
     
     *tok.end = '\0';
@@ -101,7 +95,7 @@ static int32_t parser_get_cmd(parser_t *parser) {
     char *str = parser->str;
     if(str == NULL)
         return -1;
-    parser->cmd_end = get_cmd_end(str);
+    parser->cmd_end = get_cmd_end(str, parser->end);
     if(parser->cmd_end == NULL)
         return -1;
     return parser_get_param_int(parser);
@@ -111,7 +105,7 @@ static void parser_skip_param(parser_t *parser) {
     token_t tok;
     char *str = parser->str;
     const char *end = parser->cmd_end;
-    if(!get_next_token(str, end, &tok))
+    if(!get_next_token(str, parser->end, end, &tok))
         return;
     parser->str = tok.end + 1;
 }
@@ -154,6 +148,27 @@ static void parse_mux(parser_t *parser, av_device_t *dev) {
     av_device_add_in_mux_str(dev, name);
 }
 
+static void parse_analog(parser_t *parser, av_device_t *dev) {
+    parser_skip_param(parser); // Pin
+    parser_skip_param(parser); // Sensitivity
+    const char *name = parser_get_param_str(parser);
+    if(name == NULL)
+        return;
+    av_device_add_in_analog_str(dev, name);
+}
+
+static void parse_shifter(parser_t *parser, av_device_t *dev) {
+    parser_skip_param(parser); // Latch
+    parser_skip_param(parser); // Clock
+    parser_skip_param(parser); // Data
+    int32_t module_count = parser_get_param_int(parser);
+    const char *name = parser_get_param_str(parser);
+    if(name == NULL || module_count == INT32_MAX || module_count <= 0)
+        return;
+    av_in_shifter_t *shifter = av_device_add_in_shifter_str(dev, name);
+    shifter->pins = module_count * 8 < AV_SHIFTER_MAX_PINS ? module_count * 8 : AV_SHIFTER_MAX_PINS;
+}
+
 static void parse_pwm(parser_t *parser, av_device_t *dev) {
     int32_t pin = parser_get_param_int(parser);
     parser_skip_param(parser);
@@ -178,7 +193,8 @@ void parse_config(av_device_t *dev, char *str) {
     
     parser_t parser = {
         .str = str,
-        .cmd_end = NULL
+        .cmd_end = NULL,
+        .end = str + strlen(str),
     };
     
     int32_t cmd = 0;
@@ -188,7 +204,10 @@ void parse_config(av_device_t *dev, char *str) {
             case 3: parse_pwm(&parser, dev);         break;
             case 8: parse_encoder(&parser, dev);     break;
             case 10: parse_sreg(&parser, dev);       break;
+            case 11: parse_analog(&parser, dev);     break;
+            case 12: parse_shifter(&parser, dev);    break;
             case 14: parse_mux(&parser, dev);        break;
+            case 18: parse_analog(&parser, dev);     break;
         }
     }
     parser_skip_cmd(&parser);
@@ -8,11 +8,18 @@
  *===--------------------------------------------------------------------------------------------===
 */
 #include "device_impl.h"
+#include <acfutils/time.h>
+#include <limits.h>
+#include <stdlib.h>
 
 DEFINE_BUFFER(encoder, av_in_encoder_t *);
 DEFINE_BUFFER(button, av_in_button_t *);
 DEFINE_BUFFER(mux, av_in_mux_t *);
+DEFINE_BUFFER(analog, av_in_analog_t *);
+DEFINE_BUFFER(shifter, av_in_shifter_t *);
 DEFINE_BUFFER(input, av_in_t *);
+DEFINE_BUFFER(in_id, in_id_t);
+DEFINE_BUFFER(in_event, in_event_t);
 
 DEFINE_BUFFER(output, av_out_t *);
 DEFINE_BUFFER(sreg, av_out_sreg_t *);
@@ -22,7 +29,11 @@ av_device_t *av_device_new() {
     av_device_t *dev = safe_calloc(1, sizeof(*dev));
     
     dev->serial = NULL;
+    dev->reactor = NULL;
+    dev->uring = NULL;
     dev->name[0] = '\0';
+    dev->port_path[0] = '\0';
+    dev->capture_path[0] = '\0';
     dev->serial_no[0] = '\0';
     dev->diag[0] = '\0';
     
@@ -30,20 +41,54 @@ av_device_t *av_device_new() {
     encoder_buf_init(&dev->encoders);
     button_buf_init(&dev->buttons);
     mux_buf_init(&dev->muxes);
+    analog_buf_init(&dev->analogs);
+    shifter_buf_init(&dev->shifters);
+    name_map_init(&dev->in_map);
+    dev->in_map_dirty = false;
+    in_id_buf_init(&dev->in_ids);
+    name_map_init(&dev->in_id_map);
+    in_event_buf_init(&dev->in_events);
+    dev->in_time = 0;
+    dev->in_lat_count = 0;
+    dev->in_lat_total = 0;
+    dev->in_lat_max = 0;
+    dev->in_syncing = false;
+    dev->sync_start = 0;
+    dev->sync_last = 0;
     
     output_buf_init(&dev->outputs);
     sreg_buf_init(&dev->sregs);
     pwm_buf_init(&dev->pwms);
     
-    cmd_mgr_init(&dev->mgr);
+    cmd_enc_init(&dev->enc);
+    cmd_dec_init(&dev->dec);
     memset(dev->callbacks, 0, sizeof(dev->callbacks));
     
+    dev->threaded = false;
+    dev->io_running = false;
+    atomic_init(&dev->io_run, false);
+    atomic_init(&dev->io_lost, false);
+    ring_init(&dev->rx, IO_RX_RING_SIZE);
+    ring_init(&dev->tx, IO_TX_RING_SIZE);
+    dev->io_rec_left = 0;
+    dev->io_rec_time = 0;
+    
+    device_sched_init(dev);
+    
+    atomic_init(&dev->state, AV_CONN_DISCONNECTED);
+    dev->conn_running = false;
+    dev->conn_serial = NULL;
+    mutex_init(&dev->conn_lock);
+    cv_init(&dev->conn_cv);
+    
     dev->config_req_time = 0;
 
     dev->callbacks[kEncoderChange] = callback_encoder;
     dev->callbacks[kButtonChange] = callback_button;
     dev->callbacks[kInfo] = callback_info;
     dev->callbacks[kDigInMuxChange] = callback_mux;
+    dev->callbacks[kAnalogChange] = callback_analog;
+    dev->callbacks[kInputShifterChange] = callback_shifter;
     return dev;
 }
 
@@ -63,6 +108,12 @@ static void end_commands(av_device_t *dev) {
             av_cmd_end(&mux->cmd[j]);
         }
     }
+    for(int i = 0; i < dev->shifters.count; ++i) {
+        av_in_shifter_t *shifter = dev->shifters.data[i];
+        for(int j = 0; j < AV_SHIFTER_MAX_PINS; ++j) {
+            av_cmd_end(&shifter->cmd[j]);
+        }
+    }
 }
 
 void clear_bindings(av_device_t *dev) {
@@ -74,14 +125,41 @@ void clear_bindings(av_device_t *dev) {
         free(dev->outputs.data[i]);
 }
 
+static void disconnect(av_device_t *dev) {
+    device_conn_stop(dev);
+    // Get the last commands (usually the output reset) out before the port goes away. Stopping the
+    // I/O thread drains its ring; whatever didn't fit in there is then written directly.
+    device_io_flush(dev);
+    device_io_stop(dev);
+    device_io_flush(dev);
+    if(dev->serial != NULL) {
+        serial_close(dev->serial);
+        dev->serial = NULL;
+    }
+    atomic_store(&dev->state, AV_CONN_DISCONNECTED);
+}
+
 void av_device_destroy(av_device_t *dev) {
     clear_bindings(dev);
+    disconnect(dev);
     
-    cmd_mgr_fini(&dev->mgr);
+    ring_fini(&dev->rx);
+    ring_fini(&dev->tx);
+    mutex_destroy(&dev->conn_lock);
+    cv_destroy(&dev->conn_cv);
+    device_sched_fini(dev);
+    cmd_enc_fini(&dev->enc);
+    cmd_dec_fini(&dev->dec);
     input_buf_fini(&dev->inputs);
     encoder_buf_fini(&dev->encoders);
     button_buf_fini(&dev->buttons);
     mux_buf_fini(&dev->muxes);
+    analog_buf_fini(&dev->analogs);
+    shifter_buf_fini(&dev->shifters);
+    name_map_fini(&dev->in_map);
+    in_id_buf_fini(&dev->in_ids);
+    name_map_fini(&dev->in_id_map);
+    in_event_buf_fini(&dev->in_events);
     
     output_buf_fini(&dev->outputs);
     sreg_buf_fini(&dev->sregs);
@@ -94,31 +172,29 @@ const char *av_device_get_name(const av_device_t *dev) {
     return strlen(dev->name) > 0 ? dev->name : "<no name>";
 }
 
-static void av_device_commit_output(av_device_t *dev) {
-    if(dev->serial == NULL)
-        return;
-    cmd_mgr_send_cmd_commit(&dev->mgr);
-    char buf[64];
-    int len = cmd_mgr_get_output(&dev->mgr, buf, sizeof(buf));
-    if(len == 0)
-        return;
-    serial_write(dev->serial, buf, len);
-}
-
 void av_device_set_address(av_device_t *dev, const char *address) {
-    if(dev->serial != NULL) {
-        serial_close(dev->serial);
-        dev->serial = NULL;
-        // TODO: Send some kind of "reset to default state message maybe"
-    }
-    cmd_mgr_fini(&dev->mgr);
-    cmd_mgr_init(&dev->mgr);
+    // TODO: Send some kind of "reset to default state message maybe"
+    disconnect(dev);
+    cmd_enc_reset(&dev->enc);
+    cmd_dec_reset(&dev->dec);
 
     lacf_strlcpy(dev->address, address, sizeof(dev->address));
     lacf_strlcpy(dev->name, "<no name received>", sizeof(dev->name));
     av_device_try_connect(dev);
 }
 
+void av_device_set_capture(av_device_t *dev, const char *path) {
+    lacf_strlcpy(dev->capture_path, path, sizeof(dev->capture_path));
+}
+
+const char *av_device_get_capture(const av_device_t *dev) {
+    return dev->capture_path;
+}
+
+unsigned av_device_get_framing_errors(const av_device_t *dev) {
+    return cmd_dec_get_framing_errors(&dev->dec);
+}
+
 const char *av_device_get_address(const av_device_t *dev) {
     return dev->address;
 }
@@ -130,32 +206,76 @@ bool av_device_is_connected(const av_device_t *dev) {
 bool av_device_try_connect(av_device_t *dev) {
     if(dev->serial != NULL)
         return true;
+    // Opening the port can block, so it happens on the connection thread. This only skips any
+    // backoff the thread is currently waiting out.
+    device_conn_kick(dev);
+    return false;
+}
+
+// Takes over the port once the connection thread is done with the handshake.
+static void adopt_connection(av_device_t *dev) {
+    cmd_enc_reset(&dev->enc);
+    cmd_dec_reset(&dev->dec);
+    device_sched_reset(dev);
+    device_io_start(dev);
+    dev->in_events.count = 0;
+    dev->in_lat_count = 0;
+    dev->in_lat_total = 0;
+    dev->in_lat_max = 0;
+    device_sync_inputs(dev);
     
-    dev->serial = serial_open(dev->address, SERIAL_BAUDS_115200);
-    
-    if(dev->serial == NULL)
-        return false;
-    
-    cmd_mgr_send_cmd_start(&dev->mgr, kGetInfo);
-    av_device_commit_output(dev);
-    return true;
+    // Remember which device node the address resolved to, so we still recognise it in a removal
+    // event once udev has deleted any symlink pointing to it.
+    char path[PATH_MAX];
+    if(realpath(dev->address, path) != NULL)
+        lacf_strlcpy(dev->port_path, path, sizeof(dev->port_path));
+    else
+        lacf_strlcpy(dev->port_path, dev->address, sizeof(dev->port_path));
+    logMsg("device `%s` connected on %s", dev->name, dev->address);
+}
+
+static bool is_hotplug_port(const av_device_t *dev, const char *address) {
+    if(strcmp(dev->address, address) == 0 || strcmp(dev->port_path, address) == 0)
+        return true;
+    // The address might be a udev symlink, like /dev/serial/by-id/...
+    char path[PATH_MAX];
+    return realpath(dev->address, path) != NULL && strcmp(path, address) == 0;
 }
 
+void av_device_on_hotplug(av_device_t *dev, const serial_hotplug_event_t *event) {
+    if(dev->address[0] == '\0' || !is_hotplug_port(dev, event->address))
+        return;
+    
+    if(event->action == SERIAL_HOTPLUG_REMOVED) {
+        if(dev->serial == NULL)
+            return;
+        snprintf(dev->diag, sizeof(dev->diag), "device unplugged");
+        disconnect(dev);
+        device_conn_start(dev, true);
+        return;
+    }
+    av_device_try_connect(dev);
+}
 
 void av_device_req_config(av_device_t *dev) {
     if(dev->serial == NULL)
         return;
     dev->config_req_time = time(0L);
-    char buf[128];
-    cmd_mgr_send_cmd_start(&dev->mgr, kGetConfig);
-    cmd_mgr_send_cmd_commit(&dev->mgr);
-    size_t len = cmd_mgr_get_output(&dev->mgr, buf, sizeof(buf));
-    serial_write(dev->serial, buf, len);
+    cmd_enc_send_cmd_start(&dev->enc, kGetConfig);
+    cmd_enc_send_cmd_commit(&dev->enc);
 }
 
 // MARK: - Device update
 
+static void lose_connection(av_device_t *dev) {
+    snprintf(dev->diag, sizeof(dev->diag), "connection lost");
+    disconnect(dev);
+    device_conn_start(dev, true);
+}
+
 void av_device_update(av_device_t *dev) {
+    if(device_conn_update(dev))
+        adopt_connection(dev);
     if(dev->serial == NULL)
         return;
     
@@ -169,6 +289,9 @@ void av_device_update(av_device_t *dev) {
     for(int i = 0; i < dev->muxes.count; ++i) {
         update_mux(dev->muxes.data[i]);
     }
+    for(int i = 0; i < dev->shifters.count; ++i) {
+        update_shifter(dev->shifters.data[i]);
+    }
     
     for(int i = 0; i < dev->sregs.count; ++i) {
         update_sreg(dev->sregs.data[i], dev);
@@ -177,28 +300,32 @@ void av_device_update(av_device_t *dev) {
         update_pwm(dev->pwms.data[i], dev);
     }
     
-    // Get data from the serial connection
+    // Get data from the serial connection (or the I/O thread's ring in threaded mode). Each read is
+    // decoded straight away, so a large backlog never has to fit in the command manager at once.
     char buf[512];
-    int len = serial_read(dev->serial, buf, sizeof(buf));
-    
-    if(len < 0) {
-        // Device has been lost. We need to do some stuff here
-        snprintf(dev->diag, sizeof(dev->diag), "connection lost");
-        serial_close(dev->serial);
-        dev->serial = NULL;
-        return;
-    }
-    
-    if(len > 0)
-        cmd_mgr_proccess_input(&dev->mgr, buf, len);
-    
-    // Feed data to the command manager to actually process stuff
-    int16_t cmd = 0;
-    while((cmd = cmd_mgr_get_cmd(&dev->mgr)) >= 0) {
-        if(cmd < MAX_CMD_CB && dev->callbacks[cmd] != NULL) {
-            dev->callbacks[cmd](dev);
+    int len = 0;
+    do {
+        len = device_io_read(dev, buf, sizeof(buf), &dev->in_time);
+        if(len < 0 || device_io_is_lost(dev)) {
+            lose_connection(dev);
+            return;
         }
-        cmd_mgr_skip_cmd(&dev->mgr);
-    }
+        
+        for(int off = 0; off < len;) {
+            off += cmd_dec_process_input(&dev->dec, buf + off, len - off);
+            cmd_msg_t msg;
+            while(cmd_dec_next_cmd(&dev->dec, &msg)) {
+                if(msg.id < MAX_CMD_CB && dev->callbacks[msg.id] != NULL) {
+                    dev->callbacks[msg.id](dev, &msg);
+                }
+            }
+        }
+    } while(len == sizeof(buf));
+    device_dispatch_inputs(dev);
+    
+    // Everything queued during this update goes out in a single write, within the link budget.
+    device_sched_flush(dev);
+    if(!device_io_flush(dev))
+        lose_connection(dev);
 }
 
@@ -12,6 +12,7 @@
 
 #include "bindings/inputs.h"
 #include "bindings/outputs.h"
+#include <serial/serial.h>
 #include <stdbool.h>
 #include <stdio.h>
 
@@ -21,6 +22,14 @@ extern "C" {
 
 typedef struct av_device_t av_device_t;
 
+typedef enum {
+    AV_CONN_DISCONNECTED,
+    AV_CONN_OPENING,
+    AV_CONN_HANDSHAKING,
+    AV_CONN_CONFIGURED,
+    AV_CONN_LOST,
+} av_conn_state_t;
+
 av_device_t *av_device_new();
 void av_device_destroy(av_device_t *dev);
 
@@ -29,20 +38,42 @@ void av_device_set_address(av_device_t *dev, const char *address);
 const char *av_device_get_address(const av_device_t *dev);
 bool av_device_is_connected(const av_device_t *dev);
 bool av_device_try_connect(av_device_t *dev);
+av_conn_state_t av_device_get_state(const av_device_t *dev);
+const char *av_conn_state_str(av_conn_state_t state);
+unsigned av_device_get_framing_errors(const av_device_t *dev);
+// Time from reading an input event to sending it to the sim, since the board connected.
+void av_device_get_in_latency(const av_device_t *dev, unsigned *avg_us, unsigned *max_us);
+void av_device_on_hotplug(av_device_t *dev, const serial_hotplug_event_t *event);
+
+// Records all traffic with the board to `path` (see serial_capture_start), starting from the next
+// connection. Pass an empty string to stop capturing.
+void av_device_set_capture(av_device_t *dev, const char *path);
+const char *av_device_get_capture(const av_device_t *dev);
+
+void av_device_set_threaded(av_device_t *dev, bool threaded);
+bool av_device_is_threaded(const av_device_t *dev);
+void av_device_set_reactor(av_device_t *dev, serial_reactor_t *reactor);
+void av_device_set_uring(av_device_t *dev, serial_uring_t *uring);
 
 void av_device_req_config(av_device_t *dev);
 
 int av_device_get_in_count(const av_device_t *dev);
 av_in_t *av_device_get_in(av_device_t *dev, int idx);
 void av_device_delete_in(av_device_t *dev, int idx);
+// Call after editing an input's name in place.
+void av_device_in_renamed(av_device_t *dev);
 
 av_in_encoder_t *av_device_add_in_encoder(av_device_t *dev);
 av_in_button_t *av_device_add_in_button(av_device_t *dev);
 av_in_mux_t *av_device_add_in_mux(av_device_t *dev);
+av_in_analog_t *av_device_add_in_analog(av_device_t *dev);
+av_in_shifter_t *av_device_add_in_shifter(av_device_t *dev);
 
 av_in_encoder_t *av_device_add_in_encoder_str(av_device_t *dev, const char *name);
 av_in_button_t *av_device_add_in_button_str(av_device_t *dev, const char *name);
 av_in_mux_t *av_device_add_in_mux_str(av_device_t *dev, const char *name);
+av_in_analog_t *av_device_add_in_analog_str(av_device_t *dev, const char *name);
+av_in_shifter_t *av_device_add_in_shifter_str(av_device_t *dev, const char *name);
 
 void av_device_out_reset(av_device_t *dev);
 int av_device_get_out_count(const av_device_t *dev);
@@ -32,27 +32,52 @@ static inline void write_int(FILE *out, const char *key, int value, const char *
     fprintf(out, "%s = %d%s", key, value, after);
 }
 
+static inline void write_bool(FILE *out, const char *key, bool value, const char *after) {
+    fprintf(out, "%s = %s%s", key, value ? "true" : "false", after);
+}
+
 static inline void write_float(FILE *out, const char *key, float value, const char *after) {
     fprintf(out, "%s = %f%s", key, value, after);
 }
 
+// Inputs that don't write to a dataref keep the config they had before.
+static void write_act(FILE *out, const av_dref_act_t *act) {
+    if(!strlen(act->dref.path))
+        return;
+    write_string(out, "dataref", act->dref.path, ", ");
+    if(act->index >= 0)
+        write_int(out, "dataref_index", act->index, ", ");
+    write_string(out, "dataref_op", av_act_str[act->op], ", ");
+    write_float(out, "on", act->on_val, ", ");
+    write_float(out, "off", act->off_val, ", ");
+    write_float(out, "min", act->min, ", ");
+    write_float(out, "max", act->max, ", ");
+    write_bool(out, "wrap", act->wrap, ", ");
+}
+
 static void write_encoder(FILE *out, const av_in_encoder_t *enc) {
     fprintf(out, "    { ");
     write_string(out, "name", enc->base.name, ", ");
     write_string(out, "command_up", enc->cmd_up.path, ", ");
-    write_string(out, "command_down", enc->cmd_dn.path, " }");
+    write_string(out, "command_down", enc->cmd_dn.path, ", ");
+    write_act(out, &enc->act);
+    write_int(out, "fast_steps", enc->fast_steps, ", ");
+    write_int(out, "accel_ms", enc->accel_ms, ", ");
+    write_float(out, "accel_max", enc->accel_max, ", ");
+    write_int(out, "max_per_frame", enc->max_per_frame, " }");
 }
 
 static void write_button(FILE *out, const av_in_button_t *button) {
     fprintf(out, "    { ");
     write_string(out, "name", button->base.name, ", ");
+    write_act(out, &button->act);
     write_string(out, "command", button->cmd.path, " }");
 }
 
 static void write_mux(FILE *out, const av_in_mux_t *mux) {
     bool done_first = false;
     for(int i = 0; i < AV_MUX_MAX_PINS; ++i) {
-        if(!strlen(mux->cmd[i].path))
+        if(!strlen(mux->cmd[i].path) && !strlen(mux->act[i].dref.path))
             continue;
         
         if(!done_first) {
@@ -63,10 +88,39 @@ static void write_mux(FILE *out, const av_in_mux_t *mux) {
         }
         write_string(out, "name", mux->base.name, ", ");
         write_int(out, "input", i, ", ");
+        write_act(out, &mux->act[i]);
         write_string(out, "command", mux->cmd[i].path, " }");
     }
 }
 
+static void write_shifter(FILE *out, const av_in_shifter_t *shifter) {
+    bool done_first = false;
+    for(int i = 0; i < shifter->pins; ++i) {
+        if(!strlen(shifter->cmd[i].path))
+            continue;
+        
+        if(!done_first) {
+            done_first = true;
+            fprintf(out, "    { ");
+        } else {
+            fprintf(out, ",\n    { ");
+        }
+        write_string(out, "name", shifter->base.name, ", ");
+        write_int(out, "input", i, ", ");
+        write_string(out, "command", shifter->cmd[i].path, " }");
+    }
+}
+
+static void write_analog(FILE *out, const av_in_analog_t *analog) {
+    fprintf(out, "    { ");
+    write_string(out, "name", analog->base.name, ", ");
+    write_string(out, "dataref", analog->dref.path, ", ");
+    write_float(out, "min", analog->min, ", ");
+    write_float(out, "max", analog->max, ", ");
+    write_int(out, "deadband", analog->deadband, ", ");
+    write_float(out, "smoothing", analog->smoothing, " }");
+}
+
 static void write_pwm(FILE *out, const av_out_pwm_t *pwm) {
     fprintf(out, "    { ");
     write_int(out, "pin", pwm->base.id, ", ");
@@ -101,6 +155,9 @@ void av_device_write(const av_device_t *dev, FILE *out) {
     
     write_table_array(out, "device", "\n");
     write_string(out, "port", dev->address, "\n");
+    write_bool(out, "threaded", dev->threaded, "\n");
+    if(dev->capture_path[0] != '\0')
+        write_string(out, "capture", dev->capture_path, "\n");
     
     fprintf(out, "in_encoders = [\n");
     for(int i = 0; i < dev->encoders.count; ++i) {
@@ -126,6 +183,22 @@ void av_device_write(const av_device_t *dev, FILE *out) {
     }
     fprintf(out, "]\n");
     
+    fprintf(out, "in_shifters = [\n");
+    for(int i = 0; i < dev->shifters.count; ++i) {
+        bool is_last = i == dev->shifters.count-1;
+        write_shifter(out, dev->shifters.data[i]);
+        fprintf(out, "%s\n", is_last ? "" : ",");
+    }
+    fprintf(out, "]\n");
+    
+    fprintf(out, "in_analogs = [\n");
+    for(int i = 0; i < dev->analogs.count; ++i) {
+        bool is_last = i == dev->analogs.count-1;
+        write_analog(out, dev->analogs.data[i]);
+        fprintf(out, "%s\n", is_last ? "" : ",");
+    }
+    fprintf(out, "]\n");
+    
     
     fprintf(out, "out_pwms = [\n");
     for(int i = 0; i < dev->pwms.count; ++i) {
@@ -0,0 +1,221 @@
+/*===--------------------------------------------------------------------------------------------===
+ * device_conn.c
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent. All rights reserved
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#include "device_impl.h"
+#include <acfutils/time.h>
+
+// MARK: - Connection worker
+
+static bool conn_should_run(av_device_t *dev) {
+    mutex_enter(&dev->conn_lock);
+    bool run = dev->conn_run;
+    mutex_exit(&dev->conn_lock);
+    return run;
+}
+
+// Sleeps for `ms` milliseconds, or until the flight loop kicks us. Returns false if we were asked
+// to stop.
+static bool conn_wait(av_device_t *dev, int ms) {
+    uint64_t limit = microclock() + (uint64_t)ms * 1000;
+    
+    mutex_enter(&dev->conn_lock);
+    while(dev->conn_run && !dev->conn_kick) {
+        if(cv_timedwait(&dev->conn_cv, &dev->conn_lock, limit) == ETIMEDOUT)
+            break;
+    }
+    dev->conn_kick = false;
+    bool run = dev->conn_run;
+    mutex_exit(&dev->conn_lock);
+    return run;
+}
+
+static bool send_get_info(cmd_enc_t *enc, serial_t *serial) {
+    char buf[32];
+    cmd_enc_send_cmd_start(enc, kGetInfo);
+    cmd_enc_send_cmd_commit(enc);
+    int len = cmd_enc_get_output(enc, buf, sizeof(buf));
+    return serial_write(serial, buf, len) >= 0;
+}
+
+// Most Arduinos reset when the port is opened and ignore everything until their bootloader is
+// done, so kGetInfo is re-sent until the board answers or we give up.
+static bool handshake(av_device_t *dev, serial_t *serial) {
+    cmd_enc_t enc;
+    cmd_dec_t dec;
+    cmd_enc_init(&enc);
+    cmd_dec_init(&dec);
+    
+    bool ok = false;
+    uint64_t start = microclock();
+    uint64_t last_send = 0;
+    
+    while(!ok && conn_should_run(dev)) {
+        uint64_t now = microclock();
+        if(now - start > CONN_HANDSHAKE_MS * 1000)
+            break;
+        if(last_send == 0 || now - last_send > CONN_INFO_RETRY_MS * 1000) {
+            if(!send_get_info(&enc, serial))
+                break;
+            last_send = now;
+        }
+        
+        int rc = serial_poll(serial, IO_POLL_MS * 10);
+        if(rc < 0)
+            break;
+        if(rc == 0)
+            continue;
+        
+        char buf[256];
+        int len = serial_read(serial, buf, sizeof(buf));
+        if(len < 0)
+            break;
+        cmd_dec_process_input(&dec, buf, len);
+        
+        cmd_msg_t msg;
+        while(cmd_dec_next_cmd(&dec, &msg)) {
+            if(msg.id == kInfo) {
+                cmd_msg_str(&msg, 1, dev->conn_name, sizeof(dev->conn_name));
+                cmd_msg_str(&msg, 2, dev->conn_serial_no, sizeof(dev->conn_serial_no));
+                ok = true;
+            }
+        }
+    }
+    
+    cmd_enc_fini(&enc);
+    cmd_dec_fini(&dec);
+    return ok;
+}
+
+static void conn_worker(void *arg) {
+    av_device_t *dev = arg;
+    int backoff = atomic_load(&dev->state) == AV_CONN_LOST ? CONN_BACKOFF_MIN_MS : 0;
+    
+    thread_set_name("avconnect conn");
+    
+    for(;;) {
+        if(backoff > 0 && !conn_wait(dev, backoff))
+            break;
+        if(!conn_should_run(dev))
+            break;
+        backoff = backoff > 0 ? backoff * 2 : CONN_BACKOFF_MIN_MS;
+        if(backoff > CONN_BACKOFF_MAX_MS)
+            backoff = CONN_BACKOFF_MAX_MS;
+        
+        atomic_store(&dev->state, AV_CONN_OPENING);
+        serial_t *serial = serial_open(dev->conn_address, SERIAL_BAUDS_115200);
+        if(serial == NULL) {
+            atomic_store(&dev->state, AV_CONN_DISCONNECTED);
+            continue;
+        }
+        
+        // Capture from the start, so the handshake can be replayed too.
+        if(dev->conn_capture[0] != '\0' && !serial_capture_start(serial, dev->conn_capture))
+            logMsg("unable to capture `%s` to `%s`", dev->conn_address, dev->conn_capture);
+        
+        atomic_store(&dev->state, AV_CONN_HANDSHAKING);
+        if(!handshake(dev, serial)) {
+            serial_close(serial);
+            atomic_store(&dev->state, AV_CONN_DISCONNECTED);
+            continue;
+        }
+        
+        // The flight loop picks the port up from here, see device_conn_update.
+        dev->conn_serial = serial;
+        atomic_store_explicit(&dev->state, AV_CONN_CONFIGURED, memory_order_release);
+        return;
+    }
+}
+
+// MARK: - Flight loop side
+
+void device_conn_start(av_device_t *dev, bool lost) {
+    if(dev->conn_running || dev->serial != NULL)
+        return;
+    if(dev->address[0] == '\0') {
+        atomic_store(&dev->state, AV_CONN_DISCONNECTED);
+        return;
+    }
+    
+    lacf_strlcpy(dev->conn_address, dev->address, sizeof(dev->conn_address));
+    lacf_strlcpy(dev->conn_capture, dev->capture_path, sizeof(dev->conn_capture));
+    dev->conn_serial = NULL;
+    dev->conn_run = true;
+    dev->conn_kick = false;
+    atomic_store(&dev->state, lost ? AV_CONN_LOST : AV_CONN_DISCONNECTED);
+    
+    if(!thread_create(&dev->conn_thread, conn_worker, dev)) {
+        logMsg("unable to start connection thread for `%s`", dev->address);
+        return;
+    }
+    dev->conn_running = true;
+}
+
+void device_conn_stop(av_device_t *dev) {
+    if(!dev->conn_running)
+        return;
+    mutex_enter(&dev->conn_lock);
+    dev->conn_run = false;
+    cv_broadcast(&dev->conn_cv);
+    mutex_exit(&dev->conn_lock);
+    thread_join(&dev->conn_thread);
+    dev->conn_running = false;
+    
+    // The worker may have finished the handshake after our last update.
+    if(dev->conn_serial != NULL) {
+        serial_close(dev->conn_serial);
+        dev->conn_serial = NULL;
+    }
+    atomic_store(&dev->state, AV_CONN_DISCONNECTED);
+}
+
+void device_conn_kick(av_device_t *dev) {
+    if(!dev->conn_running) {
+        device_conn_start(dev, false);
+        return;
+    }
+    mutex_enter(&dev->conn_lock);
+    dev->conn_kick = true;
+    cv_broadcast(&dev->conn_cv);
+    mutex_exit(&dev->conn_lock);
+}
+
+bool device_conn_update(av_device_t *dev) {
+    if(!dev->conn_running)
+        return false;
+    if(atomic_load_explicit(&dev->state, memory_order_acquire) != AV_CONN_CONFIGURED)
+        return false;
+    
+    // The worker has exited by now, so the join is immediate.
+    thread_join(&dev->conn_thread);
+    dev->conn_running = false;
+    
+    dev->serial = dev->conn_serial;
+    dev->conn_serial = NULL;
+    lacf_strlcpy(dev->name, dev->conn_name, sizeof(dev->name));
+    lacf_strlcpy(dev->serial_no, dev->conn_serial_no, sizeof(dev->serial_no));
+    dev->diag[0] = '\0';
+    return true;
+}
+
+// MARK: - Public API
+
+av_conn_state_t av_device_get_state(const av_device_t *dev) {
+    return atomic_load(&dev->state);
+}
+
+const char *av_conn_state_str(av_conn_state_t state) {
+    switch(state) {
+    case AV_CONN_DISCONNECTED:  return "disconnected";
+    case AV_CONN_OPENING:       return "opening";
+    case AV_CONN_HANDSHAKING:   return "handshaking";
+    case AV_CONN_CONFIGURED:    return "configured";
+    case AV_CONN_LOST:          return "lost";
+    }
+    return "unknown";
+}
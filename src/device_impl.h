@@ -12,39 +12,167 @@
 
 #include "device.h"
 #include "cmd_ids.h"
-#include "utils/cmd_mgr.h"
+#include "utils/cmd_enc.h"
+#include "utils/cmd_dec.h"
 #include "utils/buffers.h"
+#include "utils/name_map.h"
+#include "utils/ring.h"
 #include <serial/serial.h>
 #include <acfutils/helpers.h>
+#include <acfutils/thread.h>
+#include <stdatomic.h>
 #include <time.h>
 
 #define MAX_CMD_CB      (34)
 #define CONFIG_TIMEOUT  (10)
 
+#define IO_RX_RING_SIZE (16384)
+#define IO_TX_RING_SIZE (4096)
+#define IO_POLL_MS      (5)
+#define IO_DRAIN_MS     (250)
+#define IO_OUT_MAX      (16384)
+
+#define SCHED_BURST_MS      (50)
+#define SCHED_MIN_BURST     (64)
+#define SCHED_INDEX_MIN     (64)
+
+#define CONN_BACKOFF_MIN_MS (250)
+#define CONN_BACKOFF_MAX_MS (8000)
+#define CONN_HANDSHAKE_MS   (5000)
+#define CONN_INFO_RETRY_MS  (500)
+
+#define SYNC_QUIET_MS       (200)
+#define SYNC_MAX_MS         (2000)
+
 DECLARE_BUFFER(encoder, av_in_encoder_t *);
 DECLARE_BUFFER(button, av_in_button_t *);
 DECLARE_BUFFER(mux, av_in_mux_t *);
+DECLARE_BUFFER(analog, av_in_analog_t *);
+DECLARE_BUFFER(shifter, av_in_shifter_t *);
 DECLARE_BUFFER(input, av_in_t *);
 
+#define AV_IN_MAX_IDS   (1024)
+
+// An input name reported by the board, interned to its index in `in_ids`. `in` is the binding it
+// resolves to, NULL if there is none.
+typedef struct {
+    av_in_type_t    type;
+    char            name[AV_IN_NAME_MAX];
+    av_in_t         *in;
+} in_id_t;
+
+DECLARE_BUFFER(in_id, in_id_t);
+
+enum {
+    ENC_DOWN_FAST   = 0,
+    ENC_DOWN        = 1,
+    ENC_UP          = 2,
+    ENC_UP_FAST     = 3,
+};
+
+// A decoded input event, waiting to be dispatched to the sim. `time` is when its bytes came off the
+// port, in serial_now_us() time.
+typedef struct {
+    int16_t     id;
+    int16_t     pin;
+    int16_t     value;
+    uint64_t    time;
+} in_event_t;
+
+DECLARE_BUFFER(in_event, in_event_t);
+
 DECLARE_BUFFER(sreg, av_out_sreg_t *);
 DECLARE_BUFFER(pwm, av_out_pwm_t *);
 DECLARE_BUFFER(output, av_out_t *);
 
-typedef void (*cmd_cb_t)(av_device_t *dev);
+// A queued output update. Only the latest value is kept for each (cmd, module, pin) target;
+// commands that don't address a module (kSetPin) use a module of -1.
+typedef struct {
+    int16_t     cmd;
+    int16_t     module;
+    int16_t     pin;
+    int16_t     value;
+} out_entry_t;
+
+DECLARE_BUFFER(out_entry, out_entry_t);
+
+typedef void (*cmd_cb_t)(av_device_t *dev, const cmd_msg_t *msg);
 
 struct av_device_t {
     char                address[128];
+    char                port_path[128];
+    char                capture_path[256];
     char                name[128];
     char                serial_no[128];
     char                diag[128];
     
     serial_t            *serial;
-    cmd_mgr_t           mgr;
+    serial_reactor_t    *reactor;
+    serial_uring_t      *uring;
+    cmd_enc_t           enc;
+    cmd_dec_t           dec;
+    
+    // Threaded I/O mode: the I/O thread owns all serial syscalls, and talks to the flight loop
+    // through `rx` (port -> sim) and `tx` (sim -> port). Each read goes into `rx` as one record,
+    // prefixed with when it came off the port; `io_rec_left` is what the flight loop hasn't read of
+    // the current record yet.
+    bool                threaded;
+    bool                io_running;
+    thread_t            io_thread;
+    atomic_bool         io_run;
+    atomic_bool         io_lost;
+    ring_t              rx;
+    ring_t              tx;
+    int                 io_rec_left;
+    uint64_t            io_rec_time;
+    
+    // Connection worker: opens the port and runs the kGetInfo handshake with backoff. The flight
+    // loop only watches `state`, and takes `conn_serial` over once it reaches AV_CONN_CONFIGURED.
+    atomic_int          state;
+    bool                conn_running;
+    thread_t            conn_thread;
+    mutex_t             conn_lock;
+    condvar_t           conn_cv;
+    bool                conn_run;
+    bool                conn_kick;
+    serial_t            *conn_serial;
+    char                conn_address[128];
+    char                conn_capture[256];
+    char                conn_name[128];
+    char                conn_serial_no[128];
+    
+    // Outbound scheduler, paced to the port's line rate. `out_index` finds the queue slot of a
+    // (cmd, module, pin) target: open-addressed, -1 for empty, `out_index_cap` a power of two.
+    out_entry_buf_t     out_queue;
+    int                 *out_index;
+    int                 out_index_cap;
+    double              out_tokens;
+    uint64_t            out_refill_time;
     
     input_buf_t         inputs;
     encoder_buf_t       encoders;
     button_buf_t        buttons;
     mux_buf_t           muxes;
+    analog_buf_t        analogs;
+    shifter_buf_t       shifters;
+    // Named inputs by (type, name), as indices into `inputs`.
+    name_map_t          in_map;
+    bool                in_map_dirty;
+    in_id_buf_t         in_ids;
+    name_map_t          in_id_map;
+    
+    // Input events decoded this update, and how long they waited for dispatch, from when their bytes
+    // came off the port (serial_now_us() time).
+    in_event_buf_t      in_events;
+    uint64_t            in_time;
+    uint64_t            in_lat_count;
+    uint64_t            in_lat_total;
+    uint64_t            in_lat_max;
+    
+    // Switch sync after connecting: from kTrigger until the board has been quiet for SYNC_QUIET_MS.
+    bool                in_syncing;
+    uint64_t            sync_start;
+    uint64_t            sync_last;
     
     output_buf_t        outputs;
     sreg_buf_t          sregs;
@@ -56,17 +184,50 @@ struct av_device_t {
 };
 
 
-void callback_encoder(av_device_t *dev);
-void callback_button(av_device_t *dev);
-void callback_mux(av_device_t *dev);
-void callback_info(av_device_t *dev);
+void device_conn_start(av_device_t *dev, bool lost);
+void device_conn_stop(av_device_t *dev);
+void device_conn_kick(av_device_t *dev);
+bool device_conn_update(av_device_t *dev);
+
+void device_sched_init(av_device_t *dev);
+void device_sched_fini(av_device_t *dev);
+void device_sched_reset(av_device_t *dev);
+void device_sched_set(av_device_t *dev, int16_t cmd, int16_t module, int16_t pin, int16_t value);
+void device_sched_drop(av_device_t *dev, int16_t cmd, int16_t module);
+void device_sched_flush(av_device_t *dev);
+void device_sched_consume(av_device_t *dev, int bytes);
+
+// Hot commands, encoded from templates straight into the output buffer.
+void device_send_pin(av_device_t *dev, int16_t pin, int16_t value);
+void device_send_sreg_pins(av_device_t *dev, int16_t module, const int16_t *pins, int count,
+                           int16_t value);
+void device_send_brightness(av_device_t *dev, int16_t module, int16_t sub, int16_t value);
+
+bool device_io_start(av_device_t *dev);
+void device_io_stop(av_device_t *dev);
+bool device_io_is_lost(av_device_t *dev);
+int device_io_read(av_device_t *dev, char *buf, int cap, uint64_t *rx_time);
+int device_io_write(av_device_t *dev, const char *buf, int len);
+bool device_io_flush(av_device_t *dev);
+
+void callback_encoder(av_device_t *dev, const cmd_msg_t *msg);
+void callback_button(av_device_t *dev, const cmd_msg_t *msg);
+void callback_mux(av_device_t *dev, const cmd_msg_t *msg);
+void callback_analog(av_device_t *dev, const cmd_msg_t *msg);
+void callback_shifter(av_device_t *dev, const cmd_msg_t *msg);
+void callback_info(av_device_t *dev, const cmd_msg_t *msg);
+void device_dispatch_inputs(av_device_t *dev);
+void device_sync_inputs(av_device_t *dev);
 
 bool resolve_cmd(av_cmd_t *cmd);
 void update_encoder(av_in_encoder_t *enc);
 void update_button(av_in_button_t *button);
 void update_mux(av_in_mux_t *mux);
+void update_shifter(av_in_shifter_t *shifter);
 
 bool resolve_dref(av_dref_t *dref);
+float read_dref(const av_dref_t *dref);
+void write_dref(const av_dref_t *dref, float value);
 void update_sreg(av_out_sreg_t *sreg, av_device_t *dev);
 void update_pwm(av_out_pwm_t *pwm, av_device_t *dev);
 
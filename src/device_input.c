@@ -8,138 +8,219 @@
  *===--------------------------------------------------------------------------------------------===
 */
 #include "device_impl.h"
+#include <acfutils/time.h>
+#include <math.h>
 
 
-static av_in_encoder_t *find_encoder(av_device_t *dev, const char *name) {
-    for(int i = 0; i < dev->encoders.count; ++i) {
-        if(strcmp(dev->encoders.data[i]->base.name, name) == 0)
-            return dev->encoders.data[i];
-    }
-    return NULL;
+static av_in_t *lookup_input(const av_device_t *dev, av_in_type_t type, const char *name, int len) {
+    int idx = name_map_find(&dev->in_map, type, name, len);
+    return idx >= 0 ? dev->inputs.data[idx] : NULL;
 }
 
-static av_in_button_t *find_button(av_device_t *dev, const char *name) {
-    for(int i = 0; i < dev->buttons.count; ++i) {
-        if(strcmp(dev->buttons.data[i]->base.name, name) == 0)
-            return dev->buttons.data[i];
+// `in_map` is rebuilt lazily, after bindings were deleted or renamed. New named bindings go straight
+// in, so loading a config doesn't rebuild it once per input.
+static void rebuild_in_map(av_device_t *dev) {
+    name_map_clear(&dev->in_map);
+    for(int i = 0; i < dev->inputs.count; ++i) {
+        av_in_t *in = dev->inputs.data[i];
+        if(in->name[0] != '\0')
+            name_map_insert(&dev->in_map, in->type, in->name, i);
+    }
+    for(int i = 0; i < dev->in_ids.count; ++i) {
+        in_id_t *id = &dev->in_ids.data[i];
+        id->in = lookup_input(dev, id->type, id->name, (int)strlen(id->name));
     }
-    return NULL;
+    dev->in_map_dirty = false;
 }
 
-static av_in_mux_t *find_mux(av_device_t *dev, const char *name) {
-    for(int i = 0; i < dev->muxes.count; ++i) {
-        if(strcmp(dev->muxes.data[i]->base.name, name) == 0)
-            return dev->muxes.data[i];
-    }
-    return NULL;
+// Only called for the binding that was just added, which is the last one.
+static void add_to_in_map(av_device_t *dev, av_in_t *in) {
+    if(dev->in_map_dirty)
+        return;
+    int len = (int)strlen(in->name);
+    name_map_insert(&dev->in_map, in->type, in->name, dev->inputs.count - 1);
+    
+    int id = name_map_find(&dev->in_id_map, in->type, in->name, len);
+    if(id >= 0 && dev->in_ids.data[id].in == NULL)
+        dev->in_ids.data[id].in = in;
 }
 
+static av_in_t *find_input(av_device_t *dev, av_in_type_t type, const char *name) {
+    if(dev->in_map_dirty)
+        rebuild_in_map(dev);
+    return lookup_input(dev, type, name, (int)strlen(name));
+}
 
-void callback_encoder(av_device_t *dev) {
-    enum {
-        EV_DOWN_FAST    = 0,
-        EV_DOWN         = 1,
-        EV_UP           = 2,
-        EV_UP_FAST      = 3
-    };
+// Every (type, name) a board reports an event for is given a small ID the first time, and keeps it
+// for the life of the device. `in_ids` maps it to its binding, or to NULL when nothing is bound to
+// it, so events for unbound inputs cost one hash lookup and nothing else. Past AV_IN_MAX_IDS only
+// bound names are interned, so line noise can't grow the table forever.
+static int intern_input(av_device_t *dev, av_in_type_t type, const char *name, int len) {
+    int id = name_map_find(&dev->in_id_map, type, name, len);
+    if(id >= 0)
+        return id;
+    // Names that long can't be bound anyway.
+    if(len == 0 || len >= AV_IN_NAME_MAX)
+        return -1;
     
-    static char name[64];
-    if(cmd_mgr_get_arg_str(&dev->mgr, name, sizeof(name)) <= 0)
-        return;
-    av_in_encoder_t *encoder = find_encoder(dev, name);
-    if(encoder == NULL)
-        return;
+    in_id_t entry = {.type = type, .in = lookup_input(dev, type, name, len)};
+    if(entry.in == NULL && dev->in_ids.count >= AV_IN_MAX_IDS)
+        return -1;
+    memcpy(entry.name, name, len);
+    entry.name[len] = '\0';
     
-    int16_t ev = cmd_mgr_get_arg_int(&dev->mgr);
-    if(ev == INT16_MAX)
-        return;
+    const in_id_t *old = dev->in_ids.data;
+    in_id_buf_write(&dev->in_ids, entry);
+    id = dev->in_ids.count - 1;
     
-    switch(ev) {
-    case EV_DOWN_FAST:
-    case EV_DOWN:
-        av_cmd_once(&encoder->cmd_dn);
-        break;
-    case EV_UP_FAST:
-    case EV_UP:
-        av_cmd_once(&encoder->cmd_up);
-        break;
+    // The map points into `in_ids`, so it has to follow it when it grows.
+    if(dev->in_ids.data != old) {
+        name_map_clear(&dev->in_id_map);
+        for(int i = 0; i < dev->in_ids.count; ++i)
+            name_map_insert(&dev->in_id_map, dev->in_ids.data[i].type, dev->in_ids.data[i].name, i);
+    } else {
+        name_map_insert(&dev->in_id_map, type, dev->in_ids.data[id].name, id);
     }
+    return id;
+}
+
+// Resolves an event straight from the name in the message, without copying it. Returns -1 when
+// there is nothing bound to it.
+static int event_id(av_device_t *dev, av_in_type_t type, const cmd_msg_t *msg) {
+    if(msg->argc < 1)
+        return -1;
+    if(dev->in_map_dirty)
+        rebuild_in_map(dev);
+    
+    const cmd_arg_t *name = &msg->args[0];
+    int id = intern_input(dev, type, name->str, name->len);
+    if(id < 0 || dev->in_ids.data[id].in == NULL)
+        return -1;
+    return id;
+}
+
+static av_in_encoder_t *find_encoder(av_device_t *dev, const char *name) {
+    return (av_in_encoder_t *)find_input(dev, AV_IN_ENCODER, name);
+}
+
+static av_in_button_t *find_button(av_device_t *dev, const char *name) {
+    return (av_in_button_t *)find_input(dev, AV_IN_BUTTON, name);
+}
+
+static av_in_mux_t *find_mux(av_device_t *dev, const char *name) {
+    return (av_in_mux_t *)find_input(dev, AV_IN_MUX, name);
+}
+
+static av_in_analog_t *find_analog(av_device_t *dev, const char *name) {
+    return (av_in_analog_t *)find_input(dev, AV_IN_ANALOG, name);
+}
+
+static av_in_shifter_t *find_shifter(av_device_t *dev, const char *name) {
+    return (av_in_shifter_t *)find_input(dev, AV_IN_SHIFTER, name);
+}
+
+
+// MARK: - Decoding
+
+// Events are only checked and queued here, with the time their bytes came off the port. They reach
+// the sim in device_dispatch_inputs(), once the whole read has been decoded.
+static void queue_event(av_device_t *dev, int id, int16_t pin, int16_t value) {
+    in_event_t event = {
+        .id = (int16_t)id,
+        .pin = pin,
+        .value = value,
+        .time = dev->in_time,
+    };
+    in_event_buf_write(&dev->in_events, event);
 }
 
-void callback_button(av_device_t *dev) {
-    static char name[64];
-    if(cmd_mgr_get_arg_str(&dev->mgr, name, sizeof(name)) <= 0)
+void callback_encoder(av_device_t *dev, const cmd_msg_t *msg) {
+    int id = event_id(dev, AV_IN_ENCODER, msg);
+    if(id < 0)
         return;
-    av_in_button_t *button = find_button(dev, name);
-    if(button == NULL)
+    
+    int16_t ev = cmd_msg_int(msg, 1);
+    if(ev < ENC_DOWN_FAST || ev > ENC_UP_FAST)
         return;
-    if(button->cmd.ref == NULL)
+    queue_event(dev, id, 0, ev);
+}
+
+void callback_button(av_device_t *dev, const cmd_msg_t *msg) {
+    int id = event_id(dev, AV_IN_BUTTON, msg);
+    if(id < 0)
         return;
     
-    int16_t ev = cmd_mgr_get_arg_int(&dev->mgr);
+    int16_t ev = cmd_msg_int(msg, 1);
     if(ev < 0 || ev > 1)
         return;
-    
-    if(ev == 1)
-        av_cmd_begin(&button->cmd);
-    else
-        av_cmd_end(&button->cmd);
+    queue_event(dev, id, 0, ev);
 }
 
-void callback_mux(av_device_t *dev) {
-    static char name[64];
-    if(cmd_mgr_get_arg_str(&dev->mgr, name, sizeof(name)) <= 0)
-        return;
-    av_in_mux_t *mux = find_mux(dev, name);
-    if(mux == NULL)
+void callback_mux(av_device_t *dev, const cmd_msg_t *msg) {
+    int id = event_id(dev, AV_IN_MUX, msg);
+    if(id < 0)
         return;
     
-    int16_t pin = cmd_mgr_get_arg_int(&dev->mgr);
-    if(pin >= AV_MUX_MAX_PINS)
+    int16_t pin = cmd_msg_int(msg, 1);
+    if(pin < 0 || pin >= AV_MUX_MAX_PINS)
         return;
-    int16_t ev = cmd_mgr_get_arg_int(&dev->mgr);
+    int16_t ev = cmd_msg_int(msg, 2);
     if(ev < 0 || ev > 1)
         return;
+    queue_event(dev, id, pin, ev);
+}
+
+void callback_analog(av_device_t *dev, const cmd_msg_t *msg) {
+    int id = event_id(dev, AV_IN_ANALOG, msg);
+    if(id < 0)
+        return;
     
-    if(mux->cmd[pin].ref == NULL)
+    int16_t value = cmd_msg_int(msg, 1);
+    if(value < 0 || value > AV_ANALOG_MAX)
+        return;
+    queue_event(dev, id, 0, value);
+}
+
+void callback_shifter(av_device_t *dev, const cmd_msg_t *msg) {
+    int id = event_id(dev, AV_IN_SHIFTER, msg);
+    if(id < 0)
         return;
     
-    if(ev == 1)
-        av_cmd_begin(&mux->cmd[pin]);
-    else
-        av_cmd_end(&mux->cmd[pin]);
+    int16_t pin = cmd_msg_int(msg, 1);
+    if(pin < 0 || pin >= AV_SHIFTER_MAX_PINS)
+        return;
+    int16_t ev = cmd_msg_int(msg, 2);
+    if(ev < 0 || ev > 1)
+        return;
+    queue_event(dev, id, pin, ev);
 }
 
-static void callback_config(av_device_t *dev) {
-    int len = cmd_mgr_get_arg_str(&dev->mgr, NULL, 0);
+static void callback_config(av_device_t *dev, const cmd_msg_t *msg) {
+    int len = cmd_msg_str(msg, 0, NULL, 0);
     if(len <= 0)
         return;
     
     char *str = safe_calloc(len+1, 1);
-    len = cmd_mgr_get_arg_str(&dev->mgr, str, len+1);
-    str[len] = '\0';
+    cmd_msg_str(msg, 0, str, len+1);
     
     logMsg("received config: %s", str);
     parse_config(dev, str);
 }
 
-void callback_info(av_device_t *dev) {
+void callback_info(av_device_t *dev, const cmd_msg_t *msg) {
     
     time_t req_time = dev->config_req_time;
     time_t now = time(0L);
     dev->config_req_time = 0;
     if(now >= req_time && now < req_time + CONFIG_TIMEOUT) {
-        callback_config(dev);
+        callback_config(dev, msg);
         dev->config_req_time = 0;
         return;
     }
     
-    char buf_ignore[16];
-    
-    cmd_mgr_get_arg_str(&dev->mgr, buf_ignore, sizeof(buf_ignore)); // ignore <>
-    cmd_mgr_get_arg_str(&dev->mgr, dev->name, sizeof(dev->name));
-    cmd_mgr_get_arg_str(&dev->mgr, dev->serial_no, sizeof(dev->serial_no));
-    cmd_mgr_skip_cmd(&dev->mgr); // Ignore <> and <>
+    // <type>, <name>, <serial>, <firmware version>
+    cmd_msg_str(msg, 1, dev->name, sizeof(dev->name));
+    cmd_msg_str(msg, 2, dev->serial_no, sizeof(dev->serial_no));
 }
 
 // MARK: - Input Management
@@ -180,6 +261,24 @@ static void delete_mux(av_device_t *dev, av_in_mux_t *mux) {
     }
 }
 
+static void delete_analog(av_device_t *dev, av_in_analog_t *analog) {
+    for(int i = 0; i < dev->analogs.count; ++i) {
+        if(dev->analogs.data[i] == analog) {
+            analog_buf_remove(&dev->analogs, i);
+            return;
+        }
+    }
+}
+
+static void delete_shifter(av_device_t *dev, av_in_shifter_t *shifter) {
+    for(int i = 0; i < dev->shifters.count; ++i) {
+        if(dev->shifters.data[i] == shifter) {
+            shifter_buf_remove(&dev->shifters, i);
+            return;
+        }
+    }
+}
+
 void av_device_delete_in(av_device_t *dev, int idx) {
     ASSERT(idx < dev->inputs.count);
     av_in_t *binding = dev->inputs.data[idx];
@@ -193,9 +292,20 @@ void av_device_delete_in(av_device_t *dev, int idx) {
     case AV_IN_MUX:
         delete_mux(dev, (av_in_mux_t *)binding);
         break;
+    case AV_IN_ANALOG:
+        delete_analog(dev, (av_in_analog_t *)binding);
+        break;
+    case AV_IN_SHIFTER:
+        delete_shifter(dev, (av_in_shifter_t *)binding);
+        break;
     }
     input_buf_remove(&dev->inputs, idx);
     free(binding);
+    dev->in_map_dirty = true;
+}
+
+void av_device_in_renamed(av_device_t *dev) {
+    dev->in_map_dirty = true;
 }
 
 static void init_binding(void *ptr, av_in_type_t type, size_t size) {
@@ -213,6 +323,12 @@ av_in_encoder_t *av_device_add_in_encoder(av_device_t *dev) {
     input_buf_write(&dev->inputs, (av_in_t *)enc);
     av_cmd_init(&enc->cmd_dn);
     av_cmd_init(&enc->cmd_up);
+    av_dref_act_init(&enc->act);
+    enc->act.op = AV_ACT_INCR;
+    enc->fast_steps = 1;
+    enc->accel_ms = 0;
+    enc->accel_max = 1;
+    enc->max_per_frame = 0;
     return enc;
 }
 
@@ -222,6 +338,8 @@ av_in_button_t *av_device_add_in_button(av_device_t *dev) {
     button_buf_write(&dev->buttons, button);
     input_buf_write(&dev->inputs, (av_in_t *)button);
     av_cmd_init(&button->cmd);
+    av_dref_act_init(&button->act);
+    button->sync_value = -1;
     return button;
 }
 
@@ -232,40 +350,486 @@ av_in_mux_t *av_device_add_in_mux(av_device_t *dev) {
     input_buf_write(&dev->inputs, (av_in_t *)mux);
     for(int i = 0; i < AV_MUX_MAX_PINS; ++i) {
         av_cmd_init(&mux->cmd[i]);
+        av_dref_act_init(&mux->act[i]);
     }
     return mux;
 }
 
-av_in_encoder_t *av_device_add_in_encoder_str(av_device_t *dev, const char *name) {
-    for(int i = 0; i < dev->encoders.count; ++i) {
-        if(strcmp(dev->encoders.data[i]->base.name, name) == 0)
-            return dev->encoders.data[i];
+av_in_analog_t *av_device_add_in_analog(av_device_t *dev) {
+    av_in_analog_t *analog = safe_calloc(1, sizeof(*analog));
+    init_binding(analog, AV_IN_ANALOG, sizeof(*analog));
+    analog_buf_write(&dev->analogs, analog);
+    input_buf_write(&dev->inputs, (av_in_t *)analog);
+    av_dref_init(&analog->dref);
+    analog->min = 0;
+    analog->max = 1;
+    analog->deadband = 2;
+    analog->smoothing = 0.5f;
+    analog->raw = -1;
+    analog->last_out = NAN;
+    return analog;
+}
+
+av_in_shifter_t *av_device_add_in_shifter(av_device_t *dev) {
+    av_in_shifter_t *shifter = safe_calloc(1, sizeof(*shifter));
+    init_binding(shifter, AV_IN_SHIFTER, sizeof(*shifter));
+    shifter_buf_write(&dev->shifters, shifter);
+    input_buf_write(&dev->inputs, (av_in_t *)shifter);
+    shifter->pins = 8;
+    for(int i = 0; i < AV_SHIFTER_MAX_PINS; ++i) {
+        av_cmd_init(&shifter->cmd[i]);
     }
-    av_in_encoder_t *encoder = av_device_add_in_encoder(dev);
+    return shifter;
+}
+
+av_in_encoder_t *av_device_add_in_encoder_str(av_device_t *dev, const char *name) {
+    av_in_encoder_t *encoder = find_encoder(dev, name);
+    if(encoder != NULL)
+        return encoder;
+    encoder = av_device_add_in_encoder(dev);
     strlcpy(encoder->base.name, name, sizeof(encoder->base.name));
+    add_to_in_map(dev, &encoder->base);
     return encoder;
 }
 
 av_in_button_t *av_device_add_in_button_str(av_device_t *dev, const char *name) {
-    for(int i = 0; i < dev->buttons.count; ++i) {
-        if(strcmp(dev->buttons.data[i]->base.name, name) == 0)
-            return dev->buttons.data[i];
-    }
-    av_in_button_t *button = av_device_add_in_button(dev);
+    av_in_button_t *button = find_button(dev, name);
+    if(button != NULL)
+        return button;
+    button = av_device_add_in_button(dev);
     strlcpy(button->base.name, name, sizeof(button->base.name));
+    add_to_in_map(dev, &button->base);
     return button;
 }
 
 av_in_mux_t *av_device_add_in_mux_str(av_device_t *dev, const char *name) {
-    for(int i = 0; i < dev->muxes.count; ++i) {
-        if(strcmp(dev->muxes.data[i]->base.name, name) == 0)
-            return dev->muxes.data[i];
-    }
-    av_in_mux_t *mux = av_device_add_in_mux(dev);
+    av_in_mux_t *mux = find_mux(dev, name);
+    if(mux != NULL)
+        return mux;
+    mux = av_device_add_in_mux(dev);
     strlcpy(mux->base.name, name, sizeof(mux->base.name));
+    add_to_in_map(dev, &mux->base);
     return mux;
 }
 
+av_in_analog_t *av_device_add_in_analog_str(av_device_t *dev, const char *name) {
+    av_in_analog_t *analog = find_analog(dev, name);
+    if(analog != NULL)
+        return analog;
+    analog = av_device_add_in_analog(dev);
+    strlcpy(analog->base.name, name, sizeof(analog->base.name));
+    add_to_in_map(dev, &analog->base);
+    return analog;
+}
+
+av_in_shifter_t *av_device_add_in_shifter_str(av_device_t *dev, const char *name) {
+    av_in_shifter_t *shifter = find_shifter(dev, name);
+    if(shifter != NULL)
+        return shifter;
+    shifter = av_device_add_in_shifter(dev);
+    strlcpy(shifter->base.name, name, sizeof(shifter->base.name));
+    add_to_in_map(dev, &shifter->base);
+    return shifter;
+}
+
+// MARK: - Dispatch
+
+static void dispatch_encoder(av_in_encoder_t *encoder, const in_event_t *event) {
+    bool fast = event->value == ENC_DOWN_FAST || event->value == ENC_UP_FAST;
+    int steps = fast ? encoder->fast_steps : 1;
+    if(event->value == ENC_DOWN_FAST || event->value == ENC_DOWN)
+        steps = -steps;
+    
+    encoder->pending += steps;
+    encoder->detents += 1;
+    encoder->frame_time = event->time;
+}
+
+// MARK: - Dataref actions
+
+// Like resolve_dref(), except that array datarefs are fine as long as an element is picked.
+static bool resolve_act(av_dref_act_t *act) {
+    av_dref_t *dref = &act->dref;
+    if(act->index < 0)
+        return resolve_dref(dref);
+    if(!dref->has_changed)
+        return dref->has_resolved;
+    
+    dref->has_changed = false;
+    dref->ref = XPLMFindDataRef(dref->path);
+    XPLMDataTypeID types = dref->ref != NULL ? XPLMGetDataRefTypes(dref->ref) : 0;
+    if(types & xplmType_FloatArray) {
+        dref->type = AV_TYPE_FLOAT;
+    } else if(types & xplmType_IntArray) {
+        dref->type = AV_TYPE_INT;
+    } else {
+        dref->ref = NULL;
+        dref->type = AV_TYPE_INVALID;
+    }
+    return dref->has_resolved = (dref->ref != NULL);
+}
+
+static float read_act(const av_dref_act_t *act) {
+    if(act->index < 0)
+        return read_dref(&act->dref);
+    if(act->dref.type == AV_TYPE_FLOAT) {
+        float value = NAN;
+        XPLMGetDatavf(act->dref.ref, &value, act->index, 1);
+        return value;
+    }
+    int value = 0;
+    if(XPLMGetDatavi(act->dref.ref, &value, act->index, 1) != 1)
+        return NAN;
+    return value;
+}
+
+static void write_act(const av_dref_act_t *act, float value) {
+    if(act->index < 0) {
+        write_dref(&act->dref, value);
+    } else if(act->dref.type == AV_TYPE_FLOAT) {
+        XPLMSetDatavf(act->dref.ref, &value, act->index, 1);
+    } else {
+        int value_int = (int)roundf(value);
+        XPLMSetDatavi(act->dref.ref, &value_int, act->index, 1);
+    }
+}
+
+static void act_switch(av_dref_act_t *act, int value) {
+    if(!act->dref.has_resolved)
+        return;
+    if(act->op == AV_ACT_SET)
+        act->pending_set = value;
+    else if(value == 1)
+        act->pending_count += 1;
+}
+
+// Only switch positions carry over from a sync; replaying presses would toggle things.
+static void act_sync(av_dref_act_t *act, int value) {
+    if(act->op == AV_ACT_SET)
+        act_switch(act, value);
+}
+
+static void act_steps(av_dref_act_t *act, int steps) {
+    if(!act->dref.has_resolved || act->op != AV_ACT_INCR)
+        return;
+    act->pending_count += steps;
+}
+
+static float act_limit(const av_dref_act_t *act, float value) {
+    float range = act->max - act->min;
+    if(!act->wrap || range <= 0)
+        return clamp(value, act->min, act->max);
+    value = fmodf(value - act->min, range);
+    return act->min + (value < 0 ? value + range : value);
+}
+
+// Everything that happened to the dataref this frame becomes one read and one write.
+static void flush_act(av_dref_act_t *act) {
+    if(act->pending_count == 0 && act->pending_set < 0)
+        return;
+    int count = act->pending_count;
+    int set = act->pending_set;
+    act->pending_count = 0;
+    act->pending_set = -1;
+    if(!act->dref.has_resolved)
+        return;
+    
+    float value = NAN;
+    switch(act->op) {
+    case AV_ACT_SET:
+        value = set == 1 ? act->on_val : act->off_val;
+        break;
+    case AV_ACT_TOGGLE:
+        if(count % 2 == 0)
+            return;
+        value = read_act(act) == act->on_val ? act->off_val : act->on_val;
+        break;
+    case AV_ACT_INCR:
+        value = act_limit(act, read_act(act) + count * act->on_val);
+        break;
+    }
+    if(!isnan(value))
+        write_act(act, value);
+}
+
+// MARK: - Frame flush
+
+// Sends what an encoder was turned by this frame. The average interval between its detents is the
+// time since it last moved, split over this frame's detents.
+static void flush_encoder(av_in_encoder_t *encoder) {
+    if(encoder->detents == 0)
+        return;
+    
+    float steps = (float)encoder->pending;
+    if(encoder->accel_ms > 0 && encoder->accel_max > 1 && encoder->last_time != 0) {
+        float interval = (encoder->frame_time - encoder->last_time) / 1000.f / encoder->detents;
+        if(interval < encoder->accel_ms)
+            steps *= 1 + (encoder->accel_max - 1) * (1 - interval / encoder->accel_ms);
+    }
+    
+    // Whatever doesn't make a whole step waits for the next frame, unless the encoder turned around.
+    if((steps < 0) != (encoder->carry < 0))
+        encoder->carry = 0;
+    steps += encoder->carry;
+    int count = (int)steps;
+    encoder->carry = steps - count;
+    
+    int max = encoder->max_per_frame;
+    if(max > 0 && (count > max || count < -max)) {
+        count = count > 0 ? max : -max;
+        encoder->carry = 0;
+    }
+    act_steps(&encoder->act, count);
+    
+    av_cmd_t *cmd = count > 0 ? &encoder->cmd_up : &encoder->cmd_dn;
+    for(int i = 0; i < abs(count); ++i)
+        av_cmd_once(cmd);
+    
+    encoder->pending = 0;
+    encoder->detents = 0;
+    encoder->last_time = encoder->frame_time;
+}
+
+static void dispatch_button(av_device_t *dev, av_in_button_t *button, const in_event_t *event) {
+    if(dev->in_syncing) {
+        button->sync_value = event->value;
+        return;
+    }
+    if(event->value == 1)
+        av_cmd_begin(&button->cmd);
+    else
+        av_cmd_end(&button->cmd);
+    act_switch(&button->act, event->value);
+}
+
+static void dispatch_mux(av_device_t *dev, av_in_mux_t *mux, const in_event_t *event) {
+    if(dev->in_syncing) {
+        uint16_t bit = 1u << event->pin;
+        mux->sync_mask |= bit;
+        mux->sync_value = event->value == 1 ? mux->sync_value | bit : mux->sync_value & ~bit;
+        return;
+    }
+    if(event->value == 1)
+        av_cmd_begin(&mux->cmd[event->pin]);
+    else
+        av_cmd_end(&mux->cmd[event->pin]);
+    act_switch(&mux->act[event->pin], event->value);
+}
+
+static void dispatch_analog(av_in_analog_t *analog, const in_event_t *event) {
+    if(analog->raw >= 0 && abs(event->value - analog->raw) <= analog->deadband)
+        return;
+    if(analog->raw < 0)
+        analog->value = analog->min + (analog->max - analog->min) * event->value / AV_ANALOG_MAX;
+    analog->raw = event->value;
+}
+
+static void dispatch_shifter(av_in_shifter_t *shifter, const in_event_t *event) {
+    // The board may report more pins than the chain is set up for; those aren't bound to anything.
+    if(event->pin >= shifter->pins)
+        return;
+    int word = event->pin / 64;
+    uint64_t bit = 1ull << (event->pin % 64);
+    bool was_set = (shifter->next[word] & bit) != 0;
+    if(was_set == (event->value == 1))
+        return;
+    // A second change this frame takes the pin back to where it was.
+    if((shifter->next[word] ^ shifter->state[word]) & bit)
+        shifter->pulse[word] |= bit;
+    shifter->next[word] ^= bit;
+}
+
+static void shifter_edge(av_in_shifter_t *shifter, int pin, bool pressed) {
+    if(pressed)
+        av_cmd_begin(&shifter->cmd[pin]);
+    else
+        av_cmd_end(&shifter->cmd[pin]);
+}
+
+// The pins of word `w` that are part of the chain.
+static uint64_t shifter_mask(const av_in_shifter_t *shifter, int w) {
+    int left = shifter->pins - w * 64;
+    return left >= 64 ? ~0ull : left <= 0 ? 0 : (1ull << left) - 1;
+}
+
+static void flush_shifter(av_in_shifter_t *shifter) {
+    for(int w = 0; w < AV_SHIFTER_WORDS; ++w) {
+        // If the chain was shortened, pins still held past its end are released.
+        shifter->next[w] &= shifter_mask(shifter, w);
+        shifter->pulse[w] &= shifter_mask(shifter, w);
+        uint64_t changed = shifter->next[w] ^ shifter->state[w];
+        uint64_t pulse = shifter->pulse[w] & ~changed;
+        if((changed | pulse) == 0)
+            continue;
+        
+        for(uint64_t bits = changed; bits != 0; bits &= bits - 1) {
+            int bit = __builtin_ctzll(bits);
+            shifter_edge(shifter, w * 64 + bit, (shifter->next[w] >> bit) & 1);
+        }
+        // Pins that went and came back still get both edges, so a short press isn't lost.
+        for(uint64_t bits = pulse; bits != 0; bits &= bits - 1) {
+            int bit = __builtin_ctzll(bits);
+            bool set = (shifter->state[w] >> bit) & 1;
+            shifter_edge(shifter, w * 64 + bit, !set);
+            shifter_edge(shifter, w * 64 + bit, set);
+        }
+        shifter->state[w] = shifter->next[w];
+        shifter->pulse[w] = 0;
+    }
+}
+
+// Writes to the sim at most once a frame, and not at all once the filter has settled.
+static void flush_analog(av_in_analog_t *analog) {
+    if(analog->raw < 0 || !resolve_dref(&analog->dref))
+        return;
+    
+    float target = analog->min + (analog->max - analog->min) * analog->raw / AV_ANALOG_MAX;
+    float alpha = 1 - clamp(analog->smoothing, 0.f, 0.99f);
+    analog->value += alpha * (target - analog->value);
+    
+    float epsilon = fabsf(analog->max - analog->min) * 1e-4f;
+    if(fabsf(analog->value - analog->last_out) <= epsilon)
+        return;
+    analog->last_out = analog->value;
+    write_dref(&analog->dref, analog->value);
+}
+
+// MARK: - Switch sync
+
+// Asks the board for the state of every input, so the sim starts out matching the panel instead of
+// waiting for each switch to be moved.
+void device_sync_inputs(av_device_t *dev) {
+    cmd_enc_send_cmd_start(&dev->enc, kTrigger);
+    cmd_enc_send_cmd_commit(&dev->enc);
+    
+    for(int i = 0; i < dev->buttons.count; ++i)
+        dev->buttons.data[i]->sync_value = -1;
+    for(int i = 0; i < dev->muxes.count; ++i) {
+        dev->muxes.data[i]->sync_mask = 0;
+        dev->muxes.data[i]->sync_value = 0;
+    }
+    dev->in_syncing = true;
+    dev->sync_start = dev->sync_last = microclock();
+}
+
+// Applies the final reported state of every switch in one pass. Commands already in the right state
+// (most of them) are left alone by av_cmd_begin/av_cmd_end.
+static void apply_sync(av_device_t *dev) {
+    int count = 0;
+    for(int i = 0; i < dev->buttons.count; ++i) {
+        av_in_button_t *button = dev->buttons.data[i];
+        if(button->sync_value < 0)
+            continue;
+        if(button->sync_value == 1)
+            av_cmd_begin(&button->cmd);
+        else
+            av_cmd_end(&button->cmd);
+        act_sync(&button->act, button->sync_value);
+        button->sync_value = -1;
+        count += 1;
+    }
+    for(int i = 0; i < dev->muxes.count; ++i) {
+        av_in_mux_t *mux = dev->muxes.data[i];
+        for(unsigned bits = mux->sync_mask; bits != 0; bits &= bits - 1) {
+            int pin = __builtin_ctz(bits);
+            int value = (mux->sync_value >> pin) & 1;
+            if(value)
+                av_cmd_begin(&mux->cmd[pin]);
+            else
+                av_cmd_end(&mux->cmd[pin]);
+            act_sync(&mux->act[pin], value);
+            count += 1;
+        }
+        mux->sync_mask = 0;
+    }
+    // Shifters already hold their state as a bitset; anything that flickered during the sync
+    // doesn't need replaying.
+    for(int i = 0; i < dev->shifters.count; ++i) {
+        av_in_shifter_t *shifter = dev->shifters.data[i];
+        memset(shifter->pulse, 0, sizeof(shifter->pulse));
+        flush_shifter(shifter);
+    }
+    
+    dev->in_syncing = false;
+    logMsg("device `%s` synced %d switches in %d ms", dev->name, count,
+           (int)((microclock() - dev->sync_start) / 1000));
+}
+
+static void update_sync(av_device_t *dev, uint64_t now) {
+    if(dev->in_events.count > 0)
+        dev->sync_last = now;
+    if(now - dev->sync_last > SYNC_QUIET_MS * 1000 || now - dev->sync_start > SYNC_MAX_MS * 1000)
+        apply_sync(dev);
+}
+
+static void record_latency(av_device_t *dev, uint64_t latency) {
+    dev->in_lat_count += 1;
+    dev->in_lat_total += latency;
+    if(latency > dev->in_lat_max)
+        dev->in_lat_max = latency;
+}
+
+// Turns every queued event into command calls, in the order they arrived. Encoders only send their
+// net movement, once every event has been counted.
+void device_dispatch_inputs(av_device_t *dev) {
+    if(dev->in_map_dirty)
+        rebuild_in_map(dev);
+    uint64_t now = microclock();
+    uint64_t dispatch_time = serial_now_us();
+    for(int i = 0; i < dev->in_events.count; ++i) {
+        const in_event_t *event = &dev->in_events.data[i];
+        // A binding deleted since the event was decoded leaves its ID resolving to NULL.
+        av_in_t *in = dev->in_ids.data[event->id].in;
+        if(in == NULL)
+            continue;
+        
+        switch(in->type) {
+        case AV_IN_ENCODER:
+            dispatch_encoder((av_in_encoder_t *)in, event);
+            break;
+        case AV_IN_BUTTON:
+            dispatch_button(dev, (av_in_button_t *)in, event);
+            break;
+        case AV_IN_MUX:
+            dispatch_mux(dev, (av_in_mux_t *)in, event);
+            break;
+        case AV_IN_ANALOG:
+            dispatch_analog((av_in_analog_t *)in, event);
+            break;
+        case AV_IN_SHIFTER:
+            dispatch_shifter((av_in_shifter_t *)in, event);
+            break;
+        }
+        record_latency(dev, dispatch_time > event->time ? dispatch_time - event->time : 0);
+    }
+    if(dev->in_syncing)
+        update_sync(dev, now);
+    dev->in_events.count = 0;
+    
+    for(int i = 0; i < dev->encoders.count; ++i)
+        flush_encoder(dev->encoders.data[i]);
+    for(int i = 0; i < dev->analogs.count; ++i)
+        flush_analog(dev->analogs.data[i]);
+    if(!dev->in_syncing) {
+        for(int i = 0; i < dev->shifters.count; ++i)
+            flush_shifter(dev->shifters.data[i]);
+    }
+    
+    for(int i = 0; i < dev->encoders.count; ++i)
+        flush_act(&dev->encoders.data[i]->act);
+    for(int i = 0; i < dev->buttons.count; ++i)
+        flush_act(&dev->buttons.data[i]->act);
+    for(int i = 0; i < dev->muxes.count; ++i) {
+        for(int j = 0; j < AV_MUX_MAX_PINS; ++j)
+            flush_act(&dev->muxes.data[i]->act[j]);
+    }
+}
+
+void av_device_get_in_latency(const av_device_t *dev, unsigned *avg_us, unsigned *max_us) {
+    *avg_us = dev->in_lat_count > 0 ? (unsigned)(dev->in_lat_total / dev->in_lat_count) : 0;
+    *max_us = (unsigned)dev->in_lat_max;
+}
+
 // MARK: - Update Logic
 
 bool resolve_cmd(av_cmd_t *cmd) {
@@ -279,14 +843,23 @@ bool resolve_cmd(av_cmd_t *cmd) {
 void update_encoder(av_in_encoder_t *enc) {
     resolve_cmd(&enc->cmd_dn);
     resolve_cmd(&enc->cmd_up);
+    resolve_act(&enc->act);
 }
 
 void update_button(av_in_button_t *button) {
     resolve_cmd(&button->cmd);
+    resolve_act(&button->act);
 }
 
 void update_mux(av_in_mux_t *mux) {
     for(int i = 0; i < AV_MUX_MAX_PINS; ++i) {
         resolve_cmd(&mux->cmd[i]);
+        resolve_act(&mux->act[i]);
+    }
+}
+
+void update_shifter(av_in_shifter_t *shifter) {
+    for(int i = 0; i < shifter->pins; ++i) {
+        resolve_cmd(&shifter->cmd[i]);
     }
 }
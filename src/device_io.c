@@ -0,0 +1,254 @@
+/*===--------------------------------------------------------------------------------------------===
+ * device_io.c
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent. All rights reserved
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#include "device_impl.h"
+#include <acfutils/time.h>
+#include <unistd.h>
+
+// MARK: - I/O thread
+
+typedef struct {
+    uint64_t    time;
+    int32_t     len;
+} io_rec_t;
+
+typedef struct {
+    char        data[512];
+    int         len;
+    int         off;
+} io_out_t;
+
+// Writes as much of what the flight loop has queued as the port takes. Returns false if the port is
+// gone.
+static bool io_send(av_device_t *dev, io_out_t *out) {
+    if(out->off == out->len) {
+        out->len = ring_read(&dev->tx, out->data, sizeof(out->data));
+        out->off = 0;
+    }
+    if(out->off == out->len)
+        return true;
+    int len = serial_write(dev->serial, out->data + out->off, out->len - out->off);
+    if(len < 0)
+        return false;
+    out->off += len;
+    return true;
+}
+
+static bool io_has_output(av_device_t *dev, const io_out_t *out) {
+    return out->off < out->len || ring_get_size(&dev->tx) > 0;
+}
+
+static void io_worker(void *arg) {
+    av_device_t *dev = arg;
+    io_out_t out = {.len = 0, .off = 0};
+    char in[sizeof(io_rec_t) + 512];
+    
+    thread_set_name("avconnect io");
+    
+    while(atomic_load_explicit(&dev->io_run, memory_order_acquire)) {
+        // Push out whatever the flight loop has queued before we wait on the port.
+        if(!io_send(dev, &out))
+            goto lost;
+        
+        bool has_output = io_has_output(dev, &out);
+        int rc = serial_poll(dev->serial, has_output ? 1 : IO_POLL_MS);
+        if(rc < 0)
+            goto lost;
+        if(rc == 0)
+            continue;
+        
+        // If the flight loop isn't draining (sim loading, etc), leave the data in the OS buffer
+        // instead of dropping bytes in the middle of a command.
+        int space = ring_get_free(&dev->rx) - (int)sizeof(io_rec_t);
+        if(space <= 0) {
+            usleep(IO_POLL_MS * 1000);
+            continue;
+        }
+        
+        // The header and the data are published together, so the flight loop never sees half a record.
+        int cap = (int)(sizeof(in) - sizeof(io_rec_t));
+        int len = serial_read(dev->serial, in + sizeof(io_rec_t), space < cap ? space : cap);
+        if(len < 0)
+            goto lost;
+        if(len == 0)
+            continue;
+        io_rec_t rec = {.time = serial_get_rx_time(dev->serial), .len = len};
+        memcpy(in, &rec, sizeof(rec));
+        ring_write_all(&dev->rx, in, (int)sizeof(rec) + len);
+    }
+    
+    // The last thing queued before a stop is usually the output reset, and whoever takes the port
+    // over next mustn't start in the middle of a command: send everything that's left, for a while.
+    uint64_t deadline = microclock() + IO_DRAIN_MS * 1000;
+    while(io_has_output(dev, &out)) {
+        int off = out.off;
+        if(!io_send(dev, &out))
+            goto lost;
+        if(microclock() >= deadline)
+            break;
+        if(out.off == off)
+            usleep(1000);
+    }
+    return;
+    
+lost:
+    atomic_store_explicit(&dev->io_lost, true, memory_order_release);
+}
+
+bool device_io_start(av_device_t *dev) {
+    if(dev->serial == NULL)
+        return false;
+    if(!dev->threaded) {
+        // Without a dedicated thread, the shared backend (if there is one) does the syscalls.
+        if(dev->uring != NULL)
+            serial_uring_add(dev->uring, dev->serial);
+        else if(dev->reactor != NULL)
+            serial_reactor_add(dev->reactor, dev->serial);
+        return true;
+    }
+    if(dev->io_running)
+        return true;
+    
+    ring_clear(&dev->rx);
+    ring_clear(&dev->tx);
+    dev->io_rec_left = 0;
+    atomic_store(&dev->io_lost, false);
+    atomic_store(&dev->io_run, true);
+    
+    if(!thread_create(&dev->io_thread, io_worker, dev)) {
+        logMsg("unable to start I/O thread for `%s`", dev->address);
+        return false;
+    }
+    dev->io_running = true;
+    return true;
+}
+
+void device_io_stop(av_device_t *dev) {
+    if(dev->serial != NULL && dev->reactor != NULL)
+        serial_reactor_remove(dev->reactor, dev->serial);
+    if(dev->serial != NULL && dev->uring != NULL)
+        serial_uring_remove(dev->uring, dev->serial);
+    if(!dev->io_running)
+        return;
+    atomic_store_explicit(&dev->io_run, false, memory_order_release);
+    thread_join(&dev->io_thread);
+    dev->io_running = false;
+}
+
+bool device_io_is_lost(av_device_t *dev) {
+    if(!dev->io_running)
+        return false;
+    return atomic_load_explicit(&dev->io_lost, memory_order_acquire);
+}
+
+// MARK: - Flight loop side
+
+// Fills `buf` with as many records from the I/O thread as fit. `rx_time` is when the oldest of the
+// returned bytes came off the port.
+int device_io_read(av_device_t *dev, char *buf, int cap, uint64_t *rx_time) {
+    if(!dev->io_running) {
+        int len = serial_read(dev->serial, buf, cap);
+        *rx_time = serial_get_rx_time(dev->serial);
+        return len;
+    }
+    
+    int len = 0;
+    while(len < cap) {
+        if(dev->io_rec_left == 0) {
+            io_rec_t rec;
+            if(ring_get_size(&dev->rx) < (int)sizeof(rec))
+                break;
+            ring_read(&dev->rx, (char *)&rec, sizeof(rec));
+            dev->io_rec_left = rec.len;
+            dev->io_rec_time = rec.time;
+        }
+        if(len == 0)
+            *rx_time = dev->io_rec_time;
+        int num = cap - len < dev->io_rec_left ? cap - len : dev->io_rec_left;
+        num = ring_read(&dev->rx, buf + len, num);
+        len += num;
+        dev->io_rec_left -= num;
+    }
+    return len;
+}
+
+int device_io_write(av_device_t *dev, const char *buf, int len) {
+    if(!dev->io_running)
+        return serial_write(dev->serial, buf, len);
+    return ring_write(&dev->tx, buf, len);
+}
+
+// Length of the first command in `data`, up to and including its terminator. The encoder ends every
+// command with ";\r\n", which the names and numbers we send never contain, so this works from the
+// middle of a command without knowing what was escaped before it.
+static int first_cmd_len(const char *data, int len) {
+    for(int i = 0; i + 2 < len; ++i) {
+        if(data[i] == CMD_SEP && data[i + 1] == '\r' && data[i + 2] == '\n')
+            return i + 3;
+    }
+    return len;
+}
+
+// Sends everything the command manager has accumulated since the last flush with a single write.
+// Whatever the port doesn't take (partial write, EAGAIN) stays queued, in order, for the next
+// frame. Returns false if the port has been lost.
+bool device_io_flush(av_device_t *dev) {
+    if(dev->serial == NULL)
+        return true;
+    
+    int len = 0;
+    const char *data = cmd_enc_peek_output(&dev->enc, &len);
+    if(len == 0)
+        return true;
+    
+    int sent = device_io_write(dev, data, len);
+    if(sent < 0)
+        return false;
+    cmd_enc_consume_output(&dev->enc, sent);
+    device_sched_consume(dev, sent);
+    
+    // If the board stopped reading altogether, don't let the backlog grow forever. Only whole
+    // commands are dropped: one that went out in part is kept to its end, or the board would run it
+    // together with whatever it gets next.
+    if(len - sent > IO_OUT_MAX) {
+        snprintf(dev->diag, sizeof(dev->diag), "output overrun");
+        cmd_enc_truncate_output(&dev->enc, first_cmd_len(data + sent, len - sent));
+    }
+    return true;
+}
+
+// MARK: - Public API
+
+void av_device_set_threaded(av_device_t *dev, bool threaded) {
+    if(dev->threaded == threaded)
+        return;
+    device_io_stop(dev);
+    dev->threaded = threaded;
+    device_io_start(dev);
+}
+
+bool av_device_is_threaded(const av_device_t *dev) {
+    return dev->threaded;
+}
+
+void av_device_set_reactor(av_device_t *dev, serial_reactor_t *reactor) {
+    if(dev->reactor == reactor)
+        return;
+    device_io_stop(dev);
+    dev->reactor = reactor;
+    device_io_start(dev);
+}
+
+void av_device_set_uring(av_device_t *dev, serial_uring_t *uring) {
+    if(dev->uring == uring)
+        return;
+    device_io_stop(dev);
+    dev->uring = uring;
+    device_io_start(dev);
+}
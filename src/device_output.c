@@ -11,39 +11,28 @@
 #include "cmd_ids.h"
 #include <acfutils/assert.h>
 
-static void commit_cmd(cmd_mgr_t *mgr, serial_t *serial);
-
 // MARK: - Output Management
 
 static void reset_pwm(av_device_t *dev, av_out_pwm_t *pwm) {
     if(dev->serial == NULL)
         return;
     pwm->last_out = 0;
-    cmd_mgr_send_cmd_start(&dev->mgr, kSetPin);
-    cmd_mgr_send_arg_int(&dev->mgr, pwm->base.id);
-    cmd_mgr_send_arg_int(&dev->mgr, 0);
-    commit_cmd(&dev->mgr, dev->serial);
+    device_sched_drop(dev, kSetPin, -1);
+    device_send_pin(dev, pwm->base.id, 0);
 }
 
 static void reset_sreg(av_device_t *dev, av_out_sreg_t *sreg) {
     if(dev->serial == NULL)
         return;
-    char cmd[AV_SREG_MAX_PINS * 4] = "";
-    int cmd_len = 0;
+    int16_t pins[AV_SREG_MAX_PINS];
     
     for(int i = 0; i < AV_SREG_MAX_PINS; ++i) {
-        if(cmd_len > 0)
-            cmd[cmd_len++] = '|';
-        cmd_len += snprintf(cmd + cmd_len, sizeof(cmd) - cmd_len, "%d", i);
+        pins[i] = i;
         sreg->pins[i].last_out = 0;
     }
-    cmd[cmd_len] = '\0';
     
-    cmd_mgr_send_cmd_start(&dev->mgr, kSetShiftRegisterPins);
-    cmd_mgr_send_arg_int(&dev->mgr, sreg->base.id);
-    cmd_mgr_send_arg_cstr(&dev->mgr, cmd);
-    cmd_mgr_send_arg_int(&dev->mgr, 0);
-    commit_cmd(&dev->mgr, dev->serial);
+    device_sched_drop(dev, kSetShiftRegisterPins, sreg->base.id);
+    device_send_sreg_pins(dev, sreg->base.id, pins, AV_SREG_MAX_PINS, 0);
 }
 
 
@@ -152,13 +141,6 @@ av_out_pwm_t *av_device_add_out_pwm_id(av_device_t *dev, int id) {
 
 // MARK: - Update Logic
 
-static void commit_cmd(cmd_mgr_t *mgr, serial_t *serial) {
-    char buf[128];
-    cmd_mgr_send_cmd_commit(mgr);
-    size_t len = cmd_mgr_get_output(mgr, buf, sizeof(buf));
-    serial_write(serial, buf, len);
-}
-
 bool resolve_dref(av_dref_t *dref) {
     if(!dref->has_changed)
         return dref->has_resolved;
@@ -191,6 +173,36 @@ errout:
     return false;
 }
 
+float read_dref(const av_dref_t *dref) {
+    switch(dref->type) {
+    case AV_TYPE_INVALID:
+        break;
+    case AV_TYPE_FLOAT:
+        return XPLMGetDataf(dref->ref);
+    case AV_TYPE_DOUBLE:
+        return XPLMGetDatad(dref->ref);
+    case AV_TYPE_INT:
+        return XPLMGetDatai(dref->ref);
+    }
+    return NAN;
+}
+
+void write_dref(const av_dref_t *dref, float value) {
+    switch(dref->type) {
+    case AV_TYPE_INVALID:
+        break;
+    case AV_TYPE_FLOAT:
+        XPLMSetDataf(dref->ref, value);
+        break;
+    case AV_TYPE_DOUBLE:
+        XPLMSetDatad(dref->ref, value);
+        break;
+    case AV_TYPE_INT:
+        XPLMSetDatai(dref->ref, (int)roundf(value));
+        break;
+    }
+}
+
 static bool update_sreg_pin(av_out_sreg_pin_t *pin) {
     if(!resolve_dref(&pin->dref))
         return false;
@@ -248,44 +260,10 @@ static bool update_sreg_pin(av_out_sreg_pin_t *pin) {
 }
 
 void update_sreg(av_out_sreg_t *sreg, av_device_t *dev) {
-    UNUSED(sreg);
-    UNUSED(dev);
-    
-    char cmd_on[AV_SREG_MAX_PINS * 4] = "";
-    int cmd_on_len = 0;
-    
-    char cmd_off[AV_SREG_MAX_PINS * 4] = "";
-    int cmd_off_len = 0;
-    
     for(int i = 0; i < AV_SREG_MAX_PINS; ++i) {
         if(!update_sreg_pin(&sreg->pins[i]))
             continue;
-        
-        if(sreg->pins[i].last_out) {
-            if(cmd_on_len > 0)
-                cmd_on[cmd_on_len++] = '|';
-            cmd_on_len += snprintf(cmd_on + cmd_on_len, sizeof(cmd_on) - cmd_on_len, "%d", i);
-        } else {
-            if(cmd_off_len > 0)
-                cmd_off[cmd_off_len++] = '|';
-            cmd_off_len += snprintf(cmd_off + cmd_off_len, sizeof(cmd_off) - cmd_off_len, "%d", i);
-        }
-    }
-    
-    if(cmd_on_len > 0) {
-        cmd_mgr_send_cmd_start(&dev->mgr, kSetShiftRegisterPins);
-        cmd_mgr_send_arg_int(&dev->mgr, sreg->base.id);
-        cmd_mgr_send_arg_cstr(&dev->mgr, cmd_on);
-        cmd_mgr_send_arg_int(&dev->mgr, 1);
-        commit_cmd(&dev->mgr, dev->serial);
-    }
-    
-    if(cmd_off_len > 0) {
-        cmd_mgr_send_cmd_start(&dev->mgr, kSetShiftRegisterPins);
-        cmd_mgr_send_arg_int(&dev->mgr, sreg->base.id);
-        cmd_mgr_send_arg_cstr(&dev->mgr, cmd_off);
-        cmd_mgr_send_arg_int(&dev->mgr, 0);
-        commit_cmd(&dev->mgr, dev->serial);
+        device_sched_set(dev, kSetShiftRegisterPins, sreg->base.id, i, sreg->pins[i].last_out);
     }
 }
 
@@ -293,20 +271,7 @@ void update_pwm(av_out_pwm_t *pwm, av_device_t *dev) {
     if(!resolve_dref(&pwm->dref))
         return;
     
-    float value = NAN;
-    switch(pwm->dref.type) {
-    case AV_TYPE_INVALID:
-        return;
-    case AV_TYPE_FLOAT:
-        value = XPLMGetDataf(pwm->dref.ref);
-        break;
-    case AV_TYPE_DOUBLE:
-        value = XPLMGetDatad(pwm->dref.ref);
-        break;
-    case AV_TYPE_INT:
-        value = XPLMGetDatai(pwm->dref.ref);
-        break;
-    }
+    float value = read_dref(&pwm->dref);
     if(isnan(value))
         return;
     
@@ -327,8 +292,5 @@ void update_pwm(av_out_pwm_t *pwm, av_device_t *dev) {
         return;
     
     pwm->last_out = pwm_out;
-    cmd_mgr_send_cmd_start(&dev->mgr, kSetPin);
-    cmd_mgr_send_arg_int(&dev->mgr, pwm->base.id);
-    cmd_mgr_send_arg_int(&dev->mgr, pwm_out);
-    commit_cmd(&dev->mgr, dev->serial);
+    device_sched_set(dev, kSetPin, -1, pwm->base.id, pwm_out);
 }
@@ -0,0 +1,220 @@
+/*===--------------------------------------------------------------------------------------------===
+ * device_sched.c
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent. All rights reserved
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#include "device_impl.h"
+#include <acfutils/time.h>
+#include <math.h>
+
+DEFINE_BUFFER(out_entry, out_entry_t);
+
+#define SCHED_DROPPED   (-1)
+
+static const cmd_tpl_t set_pin_tpl = CMD_TPL(kSetPin, 2, CMD_TPL_NO_LIST);
+static const cmd_tpl_t set_sreg_tpl = CMD_TPL(kSetShiftRegisterPins, 3, 1);
+static const cmd_tpl_t set_brightness_tpl = CMD_TPL(kSetModuleBrightness, 3, CMD_TPL_NO_LIST);
+
+void device_sched_init(av_device_t *dev) {
+    out_entry_buf_init(&dev->out_queue);
+    dev->out_index = NULL;
+    dev->out_index_cap = 0;
+    dev->out_tokens = 0;
+    dev->out_refill_time = 0;
+}
+
+void device_sched_fini(av_device_t *dev) {
+    out_entry_buf_fini(&dev->out_queue);
+    free(dev->out_index);
+    dev->out_index = NULL;
+    dev->out_index_cap = 0;
+}
+
+// MARK: - Index
+
+// Slots are only ever added to the index. Dropped entries stay in it (they just never match) until
+// the queue is compacted, and then the index is rebuilt from scratch.
+static uint32_t target_hash(int16_t cmd, int16_t module, int16_t pin) {
+    uint64_t key = ((uint64_t)(uint16_t)cmd << 32) | ((uint64_t)(uint16_t)module << 16) | (uint16_t)pin;
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+static void index_insert(av_device_t *dev, int slot) {
+    const out_entry_t *entry = &dev->out_queue.data[slot];
+    uint32_t mask = (uint32_t)dev->out_index_cap - 1;
+    uint32_t i = target_hash(entry->cmd, entry->module, entry->pin) & mask;
+    while(dev->out_index[i] >= 0)
+        i = (i + 1) & mask;
+    dev->out_index[i] = slot;
+}
+
+// Keeps the table at most half full, so probes stay short.
+static void index_rebuild(av_device_t *dev) {
+    int cap = dev->out_index_cap > 0 ? dev->out_index_cap : SCHED_INDEX_MIN;
+    while(cap < dev->out_queue.count * 2 + 2)
+        cap *= 2;
+    if(cap != dev->out_index_cap) {
+        dev->out_index = safe_realloc(dev->out_index, cap * sizeof(*dev->out_index));
+        dev->out_index_cap = cap;
+    }
+    memset(dev->out_index, 0xff, cap * sizeof(*dev->out_index));
+    for(int i = 0; i < dev->out_queue.count; ++i)
+        index_insert(dev, i);
+}
+
+static int index_find(const av_device_t *dev, int16_t cmd, int16_t module, int16_t pin) {
+    if(dev->out_index_cap == 0)
+        return -1;
+    uint32_t mask = (uint32_t)dev->out_index_cap - 1;
+    for(uint32_t i = target_hash(cmd, module, pin) & mask; dev->out_index[i] >= 0; i = (i + 1) & mask) {
+        const out_entry_t *entry = &dev->out_queue.data[dev->out_index[i]];
+        if(entry->cmd == cmd && entry->module == module && entry->pin == pin)
+            return dev->out_index[i];
+    }
+    return -1;
+}
+
+void device_sched_reset(av_device_t *dev) {
+    dev->out_queue.count = 0;
+    if(dev->out_index_cap > 0)
+        memset(dev->out_index, 0xff, dev->out_index_cap * sizeof(*dev->out_index));
+    dev->out_tokens = 0;
+    dev->out_refill_time = 0;
+}
+
+// MARK: - Queueing
+
+void device_sched_set(av_device_t *dev, int16_t cmd, int16_t module, int16_t pin, int16_t value) {
+    // A target that's already queued keeps its place in line, but only its latest value is sent.
+    int slot = index_find(dev, cmd, module, pin);
+    if(slot >= 0) {
+        dev->out_queue.data[slot].value = value;
+        return;
+    }
+    out_entry_buf_write(&dev->out_queue, (out_entry_t){
+        .cmd = cmd,
+        .module = module,
+        .pin = pin,
+        .value = value,
+    });
+    if(dev->out_queue.count * 2 + 2 > dev->out_index_cap)
+        index_rebuild(dev);
+    else
+        index_insert(dev, dev->out_queue.count - 1);
+}
+
+void device_sched_drop(av_device_t *dev, int16_t cmd, int16_t module) {
+    for(int i = 0; i < dev->out_queue.count; ++i) {
+        out_entry_t *entry = &dev->out_queue.data[i];
+        if(entry->cmd == cmd && entry->module == module)
+            entry->cmd = SCHED_DROPPED;
+    }
+}
+
+// MARK: - Encoding
+
+void device_send_pin(av_device_t *dev, int16_t pin, int16_t value) {
+    int16_t args[] = {pin, value};
+    cmd_enc_send_tpl(&dev->enc, &set_pin_tpl, args, NULL, 0);
+}
+
+void device_send_sreg_pins(av_device_t *dev, int16_t module, const int16_t *pins, int count,
+                           int16_t value) {
+    int16_t args[] = {module, value};
+    cmd_enc_send_tpl(&dev->enc, &set_sreg_tpl, args, pins, count);
+}
+
+void device_send_brightness(av_device_t *dev, int16_t module, int16_t sub, int16_t value) {
+    int16_t args[] = {module, sub, value};
+    cmd_enc_send_tpl(&dev->enc, &set_brightness_tpl, args, NULL, 0);
+}
+
+// Shift register updates for the same module and value share one command, like update_sreg used
+// to do for each frame.
+static void encode_sreg(av_device_t *dev, int first) {
+    out_entry_t *head = &dev->out_queue.data[first];
+    int16_t pins[AV_SREG_MAX_PINS];
+    int count = 0;
+    
+    for(int i = first; i < dev->out_queue.count && count < AV_SREG_MAX_PINS; ++i) {
+        out_entry_t *entry = &dev->out_queue.data[i];
+        if(entry->cmd != head->cmd || entry->module != head->module || entry->value != head->value)
+            continue;
+        pins[count++] = entry->pin;
+        if(entry != head)
+            entry->cmd = SCHED_DROPPED;
+    }
+    device_send_sreg_pins(dev, head->module, pins, count, head->value);
+}
+
+static void encode_entry(av_device_t *dev, int idx) {
+    out_entry_t *entry = &dev->out_queue.data[idx];
+    if(entry->cmd == kSetShiftRegisterPins) {
+        encode_sreg(dev, idx);
+    } else if(entry->cmd == kSetPin && entry->module < 0) {
+        device_send_pin(dev, entry->pin, entry->value);
+    } else if(entry->cmd == kSetModuleBrightness) {
+        device_send_brightness(dev, entry->module, entry->pin, entry->value);
+    } else {
+        cmd_enc_send_cmd_start(&dev->enc, entry->cmd);
+        if(entry->module >= 0)
+            cmd_enc_send_arg_int(&dev->enc, entry->module);
+        cmd_enc_send_arg_int(&dev->enc, entry->pin);
+        cmd_enc_send_arg_int(&dev->enc, entry->value);
+        cmd_enc_send_cmd_commit(&dev->enc);
+    }
+    entry->cmd = SCHED_DROPPED;
+}
+
+// MARK: - Flush
+
+// The link budget is a token bucket refilled at the port's line rate (10 bits per byte with 8N1
+// framing). The burst cap keeps a long idle period from turning into a long backlog.
+static void refill_tokens(av_device_t *dev) {
+    uint64_t now = microclock();
+    double rate = serial_get_baud_rate(dev->serial) / 10.0;
+    double burst = fmax(rate * SCHED_BURST_MS / 1000.0, SCHED_MIN_BURST);
+    
+    if(dev->out_refill_time != 0)
+        dev->out_tokens += (now - dev->out_refill_time) * rate / 1e6;
+    else
+        dev->out_tokens = burst;
+    if(dev->out_tokens > burst)
+        dev->out_tokens = burst;
+    dev->out_refill_time = now;
+}
+
+void device_sched_flush(av_device_t *dev) {
+    if(dev->serial == NULL)
+        return;
+    refill_tokens(dev);
+    
+    // Anything already waiting in the output buffer (unsent bytes, config requests) goes first.
+    int pending = 0;
+    cmd_enc_peek_output(&dev->enc, &pending);
+    
+    for(int i = 0; i < dev->out_queue.count && pending < dev->out_tokens; ++i) {
+        if(dev->out_queue.data[i].cmd == SCHED_DROPPED)
+            continue;
+        encode_entry(dev, i);
+        cmd_enc_peek_output(&dev->enc, &pending);
+    }
+    
+    int count = 0;
+    for(int i = 0; i < dev->out_queue.count; ++i) {
+        if(dev->out_queue.data[i].cmd != SCHED_DROPPED)
+            dev->out_queue.data[count++] = dev->out_queue.data[i];
+    }
+    if(count != dev->out_queue.count) {
+        dev->out_queue.count = count;
+        index_rebuild(dev);
+    }
+}
+
+void device_sched_consume(av_device_t *dev, int bytes) {
+    dev->out_tokens -= bytes;
+}
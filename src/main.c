@@ -12,66 +12,64 @@
 #include <string.h>
 #include <unistd.h>
 #include <serial/serial.h>
-#include "utils/cmd_mgr.h"
+#include "utils/cmd_enc.h"
+#include "utils/cmd_dec.h"
 
 static int brightness = 120;
 static serial_t *serial = NULL;
 
 
-static void commit_cmd(cmd_mgr_t *mgr, serial_t *serial) {
+static void commit_cmd(cmd_enc_t *enc, serial_t *serial) {
     char buf[128];
-    size_t len = cmd_mgr_get_output(mgr, buf, sizeof(buf));
+    size_t len = cmd_enc_get_output(enc, buf, sizeof(buf));
     serial_write(serial, buf, len);
 }
 
-static void do_light_test(cmd_mgr_t *mgr) {
+static void do_light_test(cmd_enc_t *enc) {
     for(int i = 0; i < 14; ++i) {
-        cmd_mgr_send_cmd_start(mgr, 27);
-        cmd_mgr_send_arg_int(mgr, 0);
-        cmd_mgr_send_arg_int(mgr, i);
-        cmd_mgr_send_arg_int(mgr, 1);
-        cmd_mgr_send_cmd_commit(mgr);
-        commit_cmd(mgr, serial);
+        cmd_enc_send_cmd_start(enc, 27);
+        cmd_enc_send_arg_int(enc, 0);
+        cmd_enc_send_arg_int(enc, i);
+        cmd_enc_send_arg_int(enc, 1);
+        cmd_enc_send_cmd_commit(enc);
+        commit_cmd(enc, serial);
         
         usleep(100e3);
         
-        cmd_mgr_send_cmd_start(mgr, 27);
-        cmd_mgr_send_arg_int(mgr, 0);
-        cmd_mgr_send_arg_int(mgr, i);
-        cmd_mgr_send_arg_int(mgr, 0);
-        cmd_mgr_send_cmd_commit(mgr);
-        commit_cmd(mgr, serial);
+        cmd_enc_send_cmd_start(enc, 27);
+        cmd_enc_send_arg_int(enc, 0);
+        cmd_enc_send_arg_int(enc, i);
+        cmd_enc_send_arg_int(enc, 0);
+        cmd_enc_send_cmd_commit(enc);
+        commit_cmd(enc, serial);
     }
 }
 
-static void process_info(cmd_mgr_t *mgr) {
-    cmd_mgr_get_arg_str(mgr, NULL, 0);
+static void process_info(const cmd_msg_t *msg) {
     char name[64], serial_num[64];
-    cmd_mgr_get_arg_str(mgr, name, sizeof(name));
-    cmd_mgr_get_arg_str(mgr, serial_num, sizeof(serial_num));
-    cmd_mgr_get_arg_str(mgr, NULL, 0);
-    cmd_mgr_get_arg_str(mgr, NULL, 0);
+    cmd_msg_str(msg, 1, name, sizeof(name));
+    cmd_msg_str(msg, 2, serial_num, sizeof(serial_num));
     
     printf("info\t%s === %s\n", name, serial_num);
 }
 
-static void process_mux(cmd_mgr_t *mgr) {
+static void process_mux(const cmd_msg_t *msg) {
     char name[32];
-    cmd_mgr_get_arg_str(mgr, name, sizeof(name));
+    cmd_msg_str(msg, 0, name, sizeof(name));
     
-    int16_t button = cmd_mgr_get_arg_int(mgr);
-    int16_t value = cmd_mgr_get_arg_int(mgr);
+    int16_t button = cmd_msg_int(msg, 1);
+    int16_t value = cmd_msg_int(msg, 2);
     (void)button;
     (void)value;
     // printf("mux\t%s:%d: %d\n", name, button, value);
     
 }
 
-static void process_encoder(cmd_mgr_t *mgr) {
+static void process_encoder(cmd_enc_t *enc, const cmd_msg_t *msg) {
     char name[32];
-    cmd_mgr_get_arg_str(mgr, name, sizeof(name));
+    cmd_msg_str(msg, 0, name, sizeof(name));
     
-    int16_t value = cmd_mgr_get_arg_int(mgr);
+    int16_t value = cmd_msg_int(msg, 1);
     // printf("enc\t%s: %d\n", name, value);
     
     if(strcmp(name, "EC_ALT") == 0) {
@@ -86,23 +84,23 @@ static void process_encoder(cmd_mgr_t *mgr) {
         if(brightness > 250)
             brightness = 250;
         
-        cmd_mgr_send_cmd_start(mgr, 2);
-        cmd_mgr_send_arg_int(mgr, 8);
-        cmd_mgr_send_arg_int(mgr, brightness);
-        cmd_mgr_send_cmd_commit(mgr);
-        commit_cmd(mgr, serial);
+        cmd_enc_send_cmd_start(enc, 2);
+        cmd_enc_send_arg_int(enc, 8);
+        cmd_enc_send_arg_int(enc, brightness);
+        cmd_enc_send_cmd_commit(enc);
+        commit_cmd(enc, serial);
     }
 }
 
-static void process_switch(cmd_mgr_t *mgr) {
+static void process_switch(cmd_enc_t *enc, const cmd_msg_t *msg) {
     char name[32];
-    cmd_mgr_get_arg_str(mgr, name, sizeof(name));
+    cmd_msg_str(msg, 0, name, sizeof(name));
     
-    int16_t value = cmd_mgr_get_arg_int(mgr);
+    int16_t value = cmd_msg_int(msg, 1);
     (void)value;
     
     if(strcmp(name, "APR") == 0 && value == 1) {
-        do_light_test(mgr);
+        do_light_test(enc);
     }
 
 }
@@ -129,17 +127,19 @@ int main(int argc, const char **argv) {
     }
     serial_free_list(devices, device_count);
     
-    cmd_mgr_t mgr = {};
-    cmd_mgr_init(&mgr);
+    cmd_enc_t enc = {};
+    cmd_dec_t dec = {};
+    cmd_enc_init(&enc);
+    cmd_dec_init(&dec);
 
-    cmd_mgr_send_cmd_start(&mgr, 2);
-    cmd_mgr_send_arg_int(&mgr, 8);
-    cmd_mgr_send_arg_int(&mgr, 250);
-    cmd_mgr_send_cmd_commit(&mgr);
+    cmd_enc_send_cmd_start(&enc, 2);
+    cmd_enc_send_arg_int(&enc, 8);
+    cmd_enc_send_arg_int(&enc, 250);
+    cmd_enc_send_cmd_commit(&enc);
 
-    cmd_mgr_send_cmd_start(&mgr, 9);
-    cmd_mgr_send_cmd_commit(&mgr);
-    commit_cmd(&mgr, serial);
+    cmd_enc_send_cmd_start(&enc, 9);
+    cmd_enc_send_cmd_commit(&enc);
+    commit_cmd(&enc, serial);
     
     while(1) {
         char buf[512];
@@ -150,29 +150,30 @@ int main(int argc, const char **argv) {
         }
         if(len == 0)
             continue;
-        cmd_mgr_proccess_input(&mgr, buf, len);
+        cmd_dec_process_input(&dec, buf, len);
         
         
-        int16_t cmd = 0;
-        if((cmd = cmd_mgr_get_cmd(&mgr)) < 0)
+        cmd_msg_t msg;
+        if(!cmd_dec_next_cmd(&dec, &msg))
             continue;
-        switch(cmd) {
+        switch(msg.id) {
         case 6:
-            process_encoder(&mgr);
+            process_encoder(&enc, &msg);
             break;
         case 7:
-            process_switch(&mgr);
+            process_switch(&enc, &msg);
             break;
         case 10:
-            process_info(&mgr);
+            process_info(&msg);
             break;
         case 28:
             break;
         case 30:
-            process_mux(&mgr);
+            process_mux(&msg);
             break;
         }
     }
     
-    cmd_mgr_fini(&mgr);
+    cmd_enc_fini(&enc);
+    cmd_dec_fini(&dec);
 }
@@ -0,0 +1,533 @@
+/*===--------------------------------------------------------------------------------------------===
+ * mfsim.c - virtual MobiFlight board on a pseudo-terminal
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent. All rights reserved
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "cmd_ids.h"
+#include "utils/cmd_enc.h"
+#include "utils/cmd_dec.h"
+
+#define MAX_INPUTS      (64)
+#define MAX_NAME        (32)
+#define MUX_PINS        (16)
+#define ANALOG_MAX      (1023)
+#define SCRIPT_LINE     (256)
+
+typedef enum {
+    IN_BUTTON,
+    IN_ENCODER,
+    IN_MUX,
+    IN_ANALOG,
+} input_type_t;
+
+typedef struct {
+    input_type_t    type;
+    char            name[MAX_NAME];
+    int             state;          // Buttons: pressed. Muxes: one bit per pin. Analogs: the reading.
+} input_t;
+
+typedef struct {
+    const char      *name;
+    const char      *serial_no;
+    int             buttons;
+    int             encoders;
+    int             muxes;
+    int             analogs;
+    int             pwms;
+    int             sregs;
+    const char      *config;        // Raw config string, overrides the counts above
+    double          rate;           // Random events per second, 0 to disable
+    const char      *script_path;
+    const char      *record_path;
+    const char      *link_path;
+    unsigned        seed;
+} options_t;
+
+typedef struct {
+    int             master;
+    int             slave;
+    cmd_enc_t       enc;
+    cmd_dec_t       dec;
+
+    input_t         inputs[MAX_INPUTS];
+    int             input_count;
+    char            config[4096];
+
+    FILE            *script;
+    uint64_t        script_next;
+    char            script_cmd[SCRIPT_LINE];
+
+    FILE            *record;
+    uint64_t        start;
+    uint64_t        next_random;
+
+    unsigned long   events_sent;
+    unsigned long   cmds_received[256];
+    unsigned long   bytes_received;
+} sim_t;
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// MARK: - Pseudo-terminal
+
+static bool open_pty(sim_t *sim, const char *link_path) {
+    sim->master = posix_openpt(O_RDWR | O_NOCTTY);
+    if(sim->master < 0 || grantpt(sim->master) < 0 || unlockpt(sim->master) < 0) {
+        perror("mfsim: posix_openpt");
+        return false;
+    }
+    const char *slave_path = ptsname(sim->master);
+
+    // Keeping our own handle on the slave side means the master never sees a hangup when the
+    // plugin closes the port, so it can reconnect as often as it wants.
+    sim->slave = open(slave_path, O_RDWR | O_NOCTTY);
+    if(sim->slave < 0) {
+        perror("mfsim: open slave");
+        return false;
+    }
+    struct termios tio;
+    tcgetattr(sim->slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(sim->slave, TCSANOW, &tio);
+    fcntl(sim->master, F_SETFL, O_NONBLOCK);
+
+    printf("mfsim: listening on %s\n", slave_path);
+    if(link_path != NULL) {
+        unlink(link_path);
+        if(symlink(slave_path, link_path) < 0)
+            perror("mfsim: symlink");
+        else
+            printf("mfsim: linked to %s\n", link_path);
+    }
+    fflush(stdout);
+    return true;
+}
+
+static void send_raw(sim_t *sim, const char *data, int len) {
+    while(len > 0) {
+        ssize_t rc = write(sim->master, data, len);
+        if(rc < 0) {
+            if(errno == EAGAIN || errno == EINTR) {
+                struct pollfd pfd = {.fd = sim->master, .events = POLLOUT};
+                poll(&pfd, 1, 10);
+                continue;
+            }
+            return;
+        }
+        data += rc;
+        len -= rc;
+    }
+}
+
+static void send_output(sim_t *sim) {
+    int len = 0;
+    const char *data = cmd_enc_peek_output(&sim->enc, &len);
+    send_raw(sim, data, len);
+    cmd_enc_consume_output(&sim->enc, len);
+}
+
+// MARK: - Device layout
+
+static void add_input(sim_t *sim, input_type_t type, const char *name) {
+    if(sim->input_count >= MAX_INPUTS)
+        return;
+    input_t *in = &sim->inputs[sim->input_count++];
+    in->type = type;
+    in->state = type == IN_ANALOG ? ANALOG_MAX / 2 : 0;
+    snprintf(in->name, sizeof(in->name), "%s", name);
+}
+
+static void append_config(sim_t *sim, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void append_config(sim_t *sim, const char *fmt, ...) {
+    size_t len = strlen(sim->config);
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(sim->config + len, sizeof(sim->config) - len, fmt, args);
+    va_end(args);
+}
+
+// Builds the same config string a board would return to kGetConfig. Pin numbers are made up, the
+// plugin only cares about the names, PWM pins and shift register counts.
+static void build_layout(sim_t *sim, const options_t *opts) {
+    char name[MAX_NAME];
+    int pin = 2;
+
+    sim->config[0] = '\0';
+    for(int i = 0; i < opts->buttons; ++i) {
+        snprintf(name, sizeof(name), "Button%d", i + 1);
+        append_config(sim, "1.%d.%s:", pin++, name);
+    }
+    for(int i = 0; i < opts->encoders; ++i) {
+        snprintf(name, sizeof(name), "Encoder%d", i + 1);
+        append_config(sim, "8.%d.%d.0.%s:", pin, pin + 1, name);
+        pin += 2;
+    }
+    for(int i = 0; i < opts->muxes; ++i) {
+        snprintf(name, sizeof(name), "Mux%d", i + 1);
+        append_config(sim, "14.%d.%d.%d.%d.%s:", pin, pin + 1, pin + 2, pin + 3, name);
+        pin += 4;
+    }
+    for(int i = 0; i < opts->analogs; ++i) {
+        snprintf(name, sizeof(name), "Analog%d", i + 1);
+        append_config(sim, "11.%d.5.%s:", pin++, name);
+    }
+    for(int i = 0; i < opts->pwms; ++i) {
+        append_config(sim, "3.%d.Output%d:", pin++, i + 1);
+    }
+    if(opts->sregs > 0) {
+        append_config(sim, "10.%d.%d.%d.%d.ShiftRegister:", pin, pin + 1, pin + 2, opts->sregs);
+        pin += 3;
+    }
+}
+
+// Picks the inputs out of a raw config string, so random events use the right names.
+static void parse_layout(sim_t *sim, const char *config) {
+    if(config != sim->config)
+        snprintf(sim->config, sizeof(sim->config), "%s", config);
+
+    char buf[sizeof(sim->config)];
+    snprintf(buf, sizeof(buf), "%s", config);
+
+    char *save = NULL;
+    for(char *cmd = strtok_r(buf, ":", &save); cmd; cmd = strtok_r(NULL, ":", &save)) {
+        char *fields[8] = {};
+        int count = 0;
+        char *field_save = NULL;
+        for(char *f = strtok_r(cmd, ".", &field_save); f && count < 8; f = strtok_r(NULL, ".", &field_save))
+            fields[count++] = f;
+        if(count < 2)
+            continue;
+
+        switch(atoi(fields[0])) {
+        case 1: if(count >= 3) add_input(sim, IN_BUTTON, fields[2]); break;
+        case 8: if(count >= 5) add_input(sim, IN_ENCODER, fields[4]); break;
+        case 14: if(count >= 6) add_input(sim, IN_MUX, fields[5]); break;
+        case 11:
+        case 18: if(count >= 4) add_input(sim, IN_ANALOG, fields[3]); break;
+        }
+    }
+}
+
+// MARK: - Incoming commands
+
+static void record_cmd(sim_t *sim, const cmd_msg_t *msg) {
+    char args[256] = "";
+    int len = 0;
+    for(int i = 0; i < msg->argc && len < (int)sizeof(args); ++i) {
+        len += snprintf(args + len, sizeof(args) - len, ",%.*s", msg->args[i].len, msg->args[i].str);
+    }
+    if(sim->record != NULL) {
+        double t = (now_us() - sim->start) / 1e6;
+        fprintf(sim->record, "%.6f\t%d%s\n", t, msg->id, args);
+    }
+}
+
+// Like the firmware, kTrigger makes every switch report its current state.
+static void send_all_states(sim_t *sim) {
+    for(int i = 0; i < sim->input_count; ++i) {
+        const input_t *in = &sim->inputs[i];
+        if(in->type == IN_BUTTON) {
+            cmd_enc_send_cmd_start(&sim->enc, kButtonChange);
+            cmd_enc_send_arg_cstr(&sim->enc, in->name);
+            cmd_enc_send_arg_int(&sim->enc, in->state);
+            cmd_enc_send_cmd_commit(&sim->enc);
+        } else if(in->type == IN_MUX) {
+            for(int pin = 0; pin < MUX_PINS; ++pin) {
+                cmd_enc_send_cmd_start(&sim->enc, kDigInMuxChange);
+                cmd_enc_send_arg_cstr(&sim->enc, in->name);
+                cmd_enc_send_arg_int(&sim->enc, pin);
+                cmd_enc_send_arg_int(&sim->enc, (in->state >> pin) & 1);
+                cmd_enc_send_cmd_commit(&sim->enc);
+            }
+        } else if(in->type == IN_ANALOG) {
+            cmd_enc_send_cmd_start(&sim->enc, kAnalogChange);
+            cmd_enc_send_arg_cstr(&sim->enc, in->name);
+            cmd_enc_send_arg_int(&sim->enc, in->state);
+            cmd_enc_send_cmd_commit(&sim->enc);
+        }
+    }
+}
+
+static void process_input(sim_t *sim, const options_t *opts) {
+    cmd_msg_t msg;
+    while(cmd_dec_next_cmd(&sim->dec, &msg)) {
+        sim->cmds_received[msg.id & 0xff] += 1;
+
+        switch(msg.id) {
+        case kGetInfo:
+            cmd_enc_send_cmd_start(&sim->enc, kInfo);
+            cmd_enc_send_arg_cstr(&sim->enc, "MobiFlight Mega");
+            cmd_enc_send_arg_cstr(&sim->enc, opts->name);
+            cmd_enc_send_arg_cstr(&sim->enc, opts->serial_no);
+            cmd_enc_send_arg_cstr(&sim->enc, "2.5.1");
+            cmd_enc_send_cmd_commit(&sim->enc);
+            break;
+
+        case kGetConfig:
+            cmd_enc_send_cmd_start(&sim->enc, kInfo);
+            cmd_enc_send_arg_cstr(&sim->enc, sim->config);
+            cmd_enc_send_cmd_commit(&sim->enc);
+            break;
+
+        case kTrigger:
+            record_cmd(sim, &msg);
+            send_all_states(sim);
+            break;
+
+        case kSetPin:
+        case kSetShiftRegisterPins:
+        case kSetModuleBrightness:
+            record_cmd(sim, &msg);
+            break;
+        }
+    }
+    send_output(sim);
+}
+
+// MARK: - Outgoing events
+
+static void send_random_event(sim_t *sim) {
+    if(sim->input_count == 0)
+        return;
+    input_t *in = &sim->inputs[rand() % sim->input_count];
+
+    switch(in->type) {
+    case IN_BUTTON:
+        in->state = !in->state;
+        cmd_enc_send_cmd_start(&sim->enc, kButtonChange);
+        cmd_enc_send_arg_cstr(&sim->enc, in->name);
+        cmd_enc_send_arg_int(&sim->enc, in->state);
+        break;
+
+    case IN_ENCODER:
+        cmd_enc_send_cmd_start(&sim->enc, kEncoderChange);
+        cmd_enc_send_arg_cstr(&sim->enc, in->name);
+        cmd_enc_send_arg_int(&sim->enc, rand() % 4);
+        break;
+
+    case IN_MUX: {
+        int pin = rand() % MUX_PINS;
+        in->state ^= 1 << pin;
+        cmd_enc_send_cmd_start(&sim->enc, kDigInMuxChange);
+        cmd_enc_send_arg_cstr(&sim->enc, in->name);
+        cmd_enc_send_arg_int(&sim->enc, pin);
+        cmd_enc_send_arg_int(&sim->enc, (in->state >> pin) & 1);
+        break;
+    }
+
+    case IN_ANALOG:
+        // A slow random walk, like someone turning a pot.
+        in->state += rand() % 65 - 32;
+        in->state = in->state < 0 ? 0 : in->state > ANALOG_MAX ? ANALOG_MAX : in->state;
+        cmd_enc_send_cmd_start(&sim->enc, kAnalogChange);
+        cmd_enc_send_arg_cstr(&sim->enc, in->name);
+        cmd_enc_send_arg_int(&sim->enc, in->state);
+        break;
+    }
+    cmd_enc_send_cmd_commit(&sim->enc);
+    send_output(sim);
+    sim->events_sent += 1;
+}
+
+// Script lines are `<delay in ms> <raw command>`, e.g. `250 6,Encoder1,2;`. The delay is relative
+// to the previous line. Blank lines and lines starting with # are ignored.
+static bool script_next(sim_t *sim, uint64_t now) {
+    char line[SCRIPT_LINE];
+    while(fgets(line, sizeof(line), sim->script)) {
+        char *end = NULL;
+        long delay = strtol(line, &end, 10);
+        if(end == line || delay < 0)
+            continue;
+        while(*end == ' ' || *end == '\t')
+            end += 1;
+        end[strcspn(end, "\r\n")] = '\0';
+        if(*end == '\0' || *end == '#')
+            continue;
+
+        snprintf(sim->script_cmd, sizeof(sim->script_cmd), "%s\r\n", end);
+        sim->script_next = now + (uint64_t)delay * 1000;
+        return true;
+    }
+    fclose(sim->script);
+    sim->script = NULL;
+    return false;
+}
+
+static int next_timeout(sim_t *sim, uint64_t now) {
+    uint64_t next = UINT64_MAX;
+    if(sim->script != NULL)
+        next = sim->script_next;
+    if(sim->next_random != 0 && sim->next_random < next)
+        next = sim->next_random;
+    if(next == UINT64_MAX)
+        return 100;
+    return next > now ? (int)((next - now + 999) / 1000) : 0;
+}
+
+// MARK: - Main
+
+static void usage(const char *name) {
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  -n name        board name (default: mfsim)\n"
+        "  -S serial      board serial number (default: SN-MFSIM-0001)\n"
+        "  -b/-e/-m/-a N  number of buttons, encoders, input muxes and analog inputs\n"
+        "  -p/-s N        number of PWM outputs and shift register modules\n"
+        "  -c config      raw config string returned to kGetConfig (overrides -b/-e/-m/-a/-p/-s)\n"
+        "  -r rate        random input events per second\n"
+        "  -f script      replay `<delay ms> <raw command>` lines from a file\n"
+        "  -o file        record received output commands, one per line, with timestamps\n"
+        "  -l path        create a symlink to the pty at `path`\n"
+        "  -x seed        random seed\n",
+        name);
+}
+
+int main(int argc, char **argv) {
+    options_t opts = {
+        .name = "mfsim",
+        .serial_no = "SN-MFSIM-0001",
+        .buttons = 4,
+        .encoders = 2,
+        .muxes = 0,
+        .analogs = 1,
+        .pwms = 2,
+        .sregs = 1,
+        .seed = (unsigned)time(NULL),
+    };
+
+    int opt;
+    while((opt = getopt(argc, argv, "n:S:b:e:m:a:p:s:c:r:f:o:l:x:h")) != -1) {
+        switch(opt) {
+        case 'n': opts.name = optarg; break;
+        case 'S': opts.serial_no = optarg; break;
+        case 'b': opts.buttons = atoi(optarg); break;
+        case 'e': opts.encoders = atoi(optarg); break;
+        case 'm': opts.muxes = atoi(optarg); break;
+        case 'a': opts.analogs = atoi(optarg); break;
+        case 'p': opts.pwms = atoi(optarg); break;
+        case 's': opts.sregs = atoi(optarg); break;
+        case 'c': opts.config = optarg; break;
+        case 'r': opts.rate = atof(optarg); break;
+        case 'f': opts.script_path = optarg; break;
+        case 'o': opts.record_path = optarg; break;
+        case 'l': opts.link_path = optarg; break;
+        case 'x': opts.seed = (unsigned)strtoul(optarg, NULL, 10); break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    static sim_t sim = {};
+    srand(opts.seed);
+    cmd_enc_init(&sim.enc);
+    cmd_dec_init(&sim.dec);
+
+    if(opts.config == NULL) {
+        build_layout(&sim, &opts);
+    }
+    parse_layout(&sim, opts.config ? opts.config : sim.config);
+
+    if(opts.script_path != NULL) {
+        sim.script = fopen(opts.script_path, "r");
+        if(sim.script == NULL) {
+            perror("mfsim: script");
+            return 1;
+        }
+    }
+    if(opts.record_path != NULL) {
+        sim.record = strcmp(opts.record_path, "-") == 0 ? stdout : fopen(opts.record_path, "w");
+        if(sim.record == NULL) {
+            perror("mfsim: record");
+            return 1;
+        }
+    }
+    if(!open_pty(&sim, opts.link_path))
+        return 1;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    sim.start = now_us();
+    if(sim.script != NULL)
+        script_next(&sim, sim.start);
+    uint64_t random_period = opts.rate > 0 ? (uint64_t)(1e6 / opts.rate) : 0;
+    if(random_period > 0)
+        sim.next_random = sim.start + random_period;
+
+    while(running) {
+        uint64_t now = now_us();
+        struct pollfd pfd = {.fd = sim.master, .events = POLLIN};
+        int rc = poll(&pfd, 1, next_timeout(&sim, now));
+        if(rc < 0 && errno != EINTR)
+            break;
+
+        if(rc > 0 && (pfd.revents & POLLIN)) {
+            char buf[512];
+            ssize_t len = read(sim.master, buf, sizeof(buf));
+            if(len > 0) {
+                sim.bytes_received += len;
+                cmd_dec_process_input(&sim.dec, buf, len);
+                process_input(&sim, &opts);
+            }
+        }
+
+        now = now_us();
+        while(sim.script != NULL && now >= sim.script_next) {
+            send_raw(&sim, sim.script_cmd, strlen(sim.script_cmd));
+            sim.events_sent += 1;
+            if(!script_next(&sim, sim.script_next))
+                break;
+        }
+        while(random_period > 0 && now >= sim.next_random) {
+            send_random_event(&sim);
+            sim.next_random += random_period;
+        }
+    }
+
+    double elapsed = (now_us() - sim.start) / 1e6;
+    fprintf(stderr, "mfsim: %.1fs, %lu events sent, %lu bytes received\n",
+            elapsed, sim.events_sent, sim.bytes_received);
+    fprintf(stderr, "mfsim: %lu kSetPin, %lu kSetShiftRegisterPins, %lu kGetInfo, %lu kGetConfig\n",
+            sim.cmds_received[kSetPin], sim.cmds_received[kSetShiftRegisterPins],
+            sim.cmds_received[kGetInfo], sim.cmds_received[kGetConfig]);
+
+    if(sim.record != NULL && sim.record != stdout)
+        fclose(sim.record);
+    if(opts.link_path != NULL)
+        unlink(opts.link_path);
+    close(sim.slave);
+    close(sim.master);
+    cmd_enc_fini(&sim.enc);
+    cmd_dec_fini(&sim.dec);
+    return 0;
+}
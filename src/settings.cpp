@@ -74,7 +74,19 @@ public:
             if(sel_device_id >= 0) {
                 av_device_t *sel_device = avconnect_device_get(sel_device_id);
                     
-                ImGui::Text("%s", av_device_get_name(sel_device));
+                ImGui::Text("%s (%s)", av_device_get_name(sel_device),
+                            av_conn_state_str(av_device_get_state(sel_device)));
+                unsigned framing_errors = av_device_get_framing_errors(sel_device);
+                if(framing_errors > 0) {
+                    ImGui::SameLine();
+                    ImGui::TextDisabled("%u framing errors", framing_errors);
+                }
+                unsigned lat_avg = 0, lat_max = 0;
+                av_device_get_in_latency(sel_device, &lat_avg, &lat_max);
+                if(lat_max > 0) {
+                    ImGui::SameLine();
+                    ImGui::TextDisabled("input latency %u us avg, %u us max", lat_avg, lat_max);
+                }
                 portDropdown(sel_device);
                 ImGui::SameLine();
                 if(ImGui::Button("Scan")) {
@@ -84,6 +96,11 @@ public:
                 if(ImGui::Button("Request Config")) {
                     av_device_req_config(sel_device);
                 }
+                ImGui::SameLine();
+                bool threaded = av_device_is_threaded(sel_device);
+                if(ImGui::Checkbox("I/O Thread", &threaded)) {
+                    av_device_set_threaded(sel_device, threaded);
+                }
                 ImGui::BeginTabBar("Bindings");
                 if(ImGui::BeginTabItem("Inputs")) {
                     if(ImGui::BeginChild("InputsScroll")) {
@@ -112,13 +129,23 @@ public:
     
 private:
     
+#define COUNTOF(ar) (sizeof(ar) / sizeof(*ar))
+    
     void buildEncoderPad(av_in_encoder_t *encoder) {
         commandField("Command (down)", &encoder->cmd_dn);
         commandField("Command (up)", &encoder->cmd_up);
+        intField("Fast steps", &encoder->fast_steps, 1);
+        intField("Accel (ms)", &encoder->accel_ms, 0);
+        floatField("Accel max", &encoder->accel_max);
+        if(encoder->accel_max < 1)
+            encoder->accel_max = 1;
+        intField("Max per frame", &encoder->max_per_frame, 0);
+        actField("DataRef", &encoder->act, true);
     }
     
     void buildButtonPad(av_in_button_t *button) {
         commandField("Command", &button->cmd);
+        actField("DataRef", &button->act, false);
     }
     
     void buildMuxPad(av_in_mux_t *mux) {
@@ -127,10 +154,34 @@ private:
             char buf[32];
             snprintf(buf, sizeof(buf), "Command #%d", i);
             commandField(buf, &mux->cmd[i]);
+            snprintf(buf, sizeof(buf), "DataRef #%d", i);
+            actField(buf, &mux->act[i], false);
+            ImGui::PopID();
+        }
+    }
+    
+    void buildShifterPad(av_in_shifter_t *shifter) {
+        intField("Inputs", &shifter->pins, 1);
+        if(shifter->pins > AV_SHIFTER_MAX_PINS)
+            shifter->pins = AV_SHIFTER_MAX_PINS;
+        for(int i = 0; i < shifter->pins; ++i) {
+            ImGui::PushID(i);
+            char buf[32];
+            snprintf(buf, sizeof(buf), "Command #%d", i);
+            commandField(buf, &shifter->cmd[i]);
             ImGui::PopID();
         }
     }
     
+    void buildAnalogPad(av_in_analog_t *analog) {
+        drefField("DataRef", &analog->dref);
+        floatField("Min", &analog->min);
+        floatField("Max", &analog->max);
+        intField("Deadband", &analog->deadband, 0);
+        floatField("Smoothing", &analog->smoothing);
+        analog->smoothing = clamp(analog->smoothing, 0.f, 0.99f);
+    }
+    
     void buildInputsTab(av_device_t *sel_device) {
         if(sel_device == nullptr)
             return;
@@ -146,6 +197,8 @@ private:
             case AV_IN_ENCODER: header = "Encoder"; break;
             case AV_IN_BUTTON: header = "Button"; break;
             case AV_IN_MUX: header = "Multiplexer"; break;
+            case AV_IN_ANALOG: header = "Analog"; break;
+            case AV_IN_SHIFTER: header = "Input Shifter"; break;
             }
             
             if(!ImGui::CollapsingHeader(header)) {
@@ -162,7 +215,8 @@ private:
                 ImGui::PushItemWidth(-1);
                 ImGui::TableNextColumn();
                 ImGui::PopItemWidth();
-                ImGui::InputText("##ID", in->name, sizeof(in->name));
+                if(ImGui::InputText("##ID", in->name, sizeof(in->name)))
+                    av_device_in_renamed(sel_device);
             
                 switch(in->type) {
                 case AV_IN_ENCODER:
@@ -174,6 +228,12 @@ private:
                 case AV_IN_MUX:
                     buildMuxPad((av_in_mux_t *)in);
                     break;
+                case AV_IN_ANALOG:
+                    buildAnalogPad((av_in_analog_t *)in);
+                    break;
+                case AV_IN_SHIFTER:
+                    buildShifterPad((av_in_shifter_t *)in);
+                    break;
                 }
                 if(ImGui::Button("Delete")) {
                     to_delete = i;
@@ -202,10 +262,16 @@ private:
         if(ImGui::Button("Add Multiplexer")) {
             av_device_add_in_mux(sel_device);
         }
+        ImGui::SameLine();
+        if(ImGui::Button("Add Analog")) {
+            av_device_add_in_analog(sel_device);
+        }
+        ImGui::SameLine();
+        if(ImGui::Button("Add Input Shifter")) {
+            av_device_add_in_shifter(sel_device);
+        }
     }
     
-#define COUNTOF(ar) (sizeof(ar) / sizeof(*ar))
-    
     void buildPWMPad(av_out_pwm_t *pwm) {
         drefField("DataRef", &pwm->dref);
         ImGui::TableNextColumn();
@@ -366,6 +432,31 @@ private:
         }
     }
     
+    void intField(const char *label, int *value, int min) {
+        ImGui::TableNextColumn();
+        ImGui::Text("%s", label);
+        ImGui::TableNextColumn();
+        
+        char label_id[64];
+        snprintf(label_id, sizeof(label_id), "##%s", label);
+        ImGui::PushItemWidth(-1);
+        if(ImGui::InputInt(label_id, value) && *value < min)
+            *value = min;
+        ImGui::PopItemWidth();
+    }
+    
+    void floatField(const char *label, float *value) {
+        ImGui::TableNextColumn();
+        ImGui::Text("%s", label);
+        ImGui::TableNextColumn();
+        
+        char label_id[64];
+        snprintf(label_id, sizeof(label_id), "##%s", label);
+        ImGui::PushItemWidth(-1);
+        ImGui::InputFloat(label_id, value);
+        ImGui::PopItemWidth();
+    }
+    
     void dropdown(const char *label, const char **options, int count, int& sel) {
         int value = -1;
         if(ImGui::BeginCombo(label, options[sel])) {
@@ -413,6 +504,49 @@ private:
         }
     }
     
+    // The action's settings only show up once it has a dataref to write to. Encoders can only step
+    // it (`incr_only`), so they don't get a choice of action.
+    void actField(const char *label, av_dref_act_t *act, bool incr_only) {
+        drefField(label, &act->dref);
+        if(!strlen(act->dref.path))
+            return;
+        
+        if(incr_only) {
+            act->op = AV_ACT_INCR;
+        } else {
+            ImGui::TableNextColumn();
+            ImGui::Text("Action");
+            ImGui::TableNextColumn();
+            ImGui::PushItemWidth(-1);
+            dropdown("##act_op", av_act_str, COUNTOF(av_act_str), (int&)act->op);
+            ImGui::PopItemWidth();
+        }
+        
+        ImGui::TableNextColumn();
+        ImGui::Text("Index");
+        ImGui::TableNextColumn();
+        ImGui::PushItemWidth(-1);
+        if(ImGui::InputInt("##act_index", &act->index)) {
+            if(act->index < -1)
+                act->index = -1;
+            act->dref.has_changed = true;
+            act->dref.has_resolved = false;
+        }
+        ImGui::PopItemWidth();
+        
+        floatField(act->op == AV_ACT_INCR ? "Step" : "On", &act->on_val);
+        if(act->op != AV_ACT_INCR)
+            floatField("Off", &act->off_val);
+        if(act->op == AV_ACT_INCR) {
+            floatField("Min", &act->min);
+            floatField("Max", &act->max);
+            ImGui::TableNextColumn();
+            ImGui::Text("Wrap");
+            ImGui::TableNextColumn();
+            ImGui::Checkbox("##act_wrap", &act->wrap);
+        }
+    }
+    
     static constexpr int max_ports = 64;
     serial_info_t   ports[max_ports];
     int             port_count = 0;
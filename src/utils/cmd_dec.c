@@ -0,0 +1,284 @@
+/*===--------------------------------------------------------------------------------------------===
+ * cmd_dec.c
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent. All rights reserved
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#include "cmd_dec.h"
+#include "cmd_proto.h"
+#include "scan.h"
+#include <assert.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if CMD_DEBUG
+#include <acfutils/log.h>
+#endif
+
+static const scan_set_t special_chars = {{CMD_FIELD_SEP, CMD_SEP, CMD_ESCAPE, CMD_FIELD_SEP}, 3};
+static const scan_set_t resync_chars = {{CMD_SEP, '\n', CMD_SEP, CMD_SEP}, 2};
+
+static void reset_decoder(cmd_dec_t *dec) {
+    dec->scan_pos = dec->cmd_pos;
+    dec->write_pos = dec->cmd_pos;
+    dec->arg_start = dec->cmd_pos;
+    dec->in_cmd = false;
+    dec->escaped = false;
+    dec->argc = 0;
+}
+
+void cmd_dec_init(cmd_dec_t *dec) {
+    cmd_dec_init_cap(dec, CMD_DEC_CAP);
+}
+
+void cmd_dec_init_cap(cmd_dec_t *dec, int cap) {
+    if(cap < CMD_DEC_MIN_CAP)
+        cap = CMD_DEC_MIN_CAP;
+    dec->data = malloc(cap);
+    assert(dec->data && "failure to allocate data");
+    dec->cap = cap;
+    dec->size = 0;
+    dec->resync = false;
+    dec->framing_errors = 0;
+    dec->cmd_pos = 0;
+    reset_decoder(dec);
+}
+
+void cmd_dec_fini(cmd_dec_t *dec) {
+    free(dec->data);
+    dec->data = NULL;
+    dec->cap = 0;
+    dec->size = 0;
+    dec->cmd_pos = 0;
+    reset_decoder(dec);
+}
+
+// Forgets all pending input, keeping the buffer for the next connection.
+void cmd_dec_reset(cmd_dec_t *dec) {
+    dec->size = 0;
+    dec->cmd_pos = 0;
+    dec->resync = false;
+    reset_decoder(dec);
+}
+
+unsigned cmd_dec_get_framing_errors(const cmd_dec_t *dec) {
+    return dec->framing_errors;
+}
+
+// Decoding only moves the read cursor. What has been decoded is dropped here, once per batch of
+// input, which also means argument views don't outlive the next call.
+static void compact_input(cmd_dec_t *dec) {
+    int drop = dec->cmd_pos;
+    if(drop == 0)
+        return;
+    memmove(dec->data, dec->data + drop, dec->size - drop);
+    dec->size -= drop;
+    dec->cmd_pos = 0;
+    dec->scan_pos -= drop;
+    dec->write_pos -= drop;
+    dec->arg_start -= drop;
+    for(int i = 0; i < dec->argc; ++i)
+        dec->spans[i].start -= drop;
+}
+
+// A buffer full of one unfinished command can only be noise: we're probably at the wrong baud rate,
+// or listening to a bootloader. Everything buffered goes, and so does the rest of the line it was on.
+static void drop_input(cmd_dec_t *dec) {
+    dec->size = 0;
+    dec->cmd_pos = 0;
+    reset_decoder(dec);
+    dec->resync = true;
+    dec->framing_errors += 1;
+}
+
+// Takes as much input as fits and returns how much that was. Callers decode everything they can
+// with cmd_dec_next_cmd() before handing over the rest.
+int cmd_dec_process_input(cmd_dec_t *dec, const char *str, int len) {
+    compact_input(dec);
+    
+    int taken = 0;
+    while(taken < len) {
+        if(dec->resync) {
+            const char *end = scan_find(str + taken, str + len, &resync_chars);
+            if(end == str + len)
+                return len;
+            taken = (int)(end + 1 - str);
+            dec->resync = false;
+            continue;
+        }
+        
+        // Until the decoder has looked at everything, the buffer might still hold complete commands.
+        int space = dec->cap - dec->size;
+        if(space == 0) {
+            if(dec->scan_pos < dec->size)
+                break;
+            drop_input(dec);
+            continue;
+        }
+        
+        int num = len - taken < space ? len - taken : space;
+        memcpy(dec->data + dec->size, str + taken, num);
+        dec->size += num;
+        taken += num;
+    }
+#if CMD_DEBUG
+    logMsg("in msg: %.*s", dec->size, dec->data);
+#endif
+    return taken;
+}
+
+static bool parse_int(const char *str, int len, int *out) {
+    int i = 0;
+    bool neg = false;
+    while(i < len && isspace((unsigned char)str[i]))
+        i += 1;
+    if(i < len && (str[i] == '-' || str[i] == '+')) {
+        neg = str[i] == '-';
+        i += 1;
+    }
+    if(i == len)
+        return false;
+    
+    int val = 0;
+    for(; i < len; ++i) {
+        if(str[i] < '0' || str[i] > '9')
+            return false;
+        val = val * 10 + (str[i] - '0');
+        if(val > INT16_MAX + (neg ? 1 : 0))
+            return false;
+    }
+    *out = neg ? -val : val;
+    return true;
+}
+
+static void end_arg(cmd_dec_t *dec, int start, int end) {
+    // Arguments past CMD_MAX_ARGS are dropped, the command itself is still decoded.
+    if(dec->argc < CMD_MAX_ARGS + 1) {
+        dec->spans[dec->argc].start = start;
+        dec->spans[dec->argc].len = end - start;
+        dec->argc += 1;
+    }
+}
+
+static bool finish_cmd(cmd_dec_t *dec, const char *data, cmd_msg_t *msg) {
+    // Anything that doesn't start with a command id is noise; skip it.
+    int id = 0;
+    if(!parse_int(data + dec->spans[0].start, dec->spans[0].len, &id) || id < 0)
+        return false;
+    
+    msg->id = (int16_t)id;
+    msg->argc = dec->argc - 1;
+    for(int i = 0; i < msg->argc; ++i) {
+        msg->args[i].str = data + dec->spans[i + 1].start;
+        msg->args[i].len = dec->spans[i + 1].len;
+    }
+    return true;
+}
+
+// Every byte is looked at once, however the command is split across reads. Escaped arguments are
+// unescaped in place, over bytes that have already been decoded; the rest of the buffer is
+// only read.
+bool cmd_dec_next_cmd(cmd_dec_t *dec, cmd_msg_t *msg) {
+    char *data = dec->data;
+    if(data == NULL)
+        return false;
+    int size = dec->size;
+    
+    // Stores into `data` could alias the decoder state, keep it in locals while scanning.
+    int pos = dec->scan_pos;
+    int write = dec->write_pos;
+    int arg_start = dec->arg_start;
+    bool in_cmd = dec->in_cmd;
+    bool escaped = dec->escaped;
+    bool found = false;
+    
+    while(pos < size) {
+        if(!in_cmd) {
+            if(isspace((unsigned char)data[pos])) {
+                pos += 1;
+                write = arg_start = dec->cmd_pos = pos;
+                continue;
+            }
+            in_cmd = true;
+        }
+        
+        if(escaped) {
+            if(write != pos)
+                data[write] = data[pos];
+            write += 1;
+            pos += 1;
+            escaped = false;
+            continue;
+        }
+        
+        // Everything up to the next separator or escape belongs to the current argument.
+        int run = (int)(scan_find(data + pos, data + size, &special_chars) - (data + pos));
+        if(write != pos)
+            memmove(data + write, data + pos, run);
+        write += run;
+        pos += run;
+        if(pos == size)
+            break;
+        
+        char c = data[pos++];
+        if(c == CMD_ESCAPE) {
+            escaped = true;
+        } else if(c == CMD_FIELD_SEP) {
+            end_arg(dec, arg_start, write);
+            write = arg_start = pos;
+        } else {
+            end_arg(dec, arg_start, write);
+            found = finish_cmd(dec, data, msg);
+            dec->argc = 0;
+            write = arg_start = dec->cmd_pos = pos;
+            in_cmd = false;
+            if(found)
+                break;
+        }
+    }
+    
+    dec->scan_pos = pos;
+    dec->write_pos = write;
+    dec->arg_start = arg_start;
+    dec->in_cmd = in_cmd;
+    dec->escaped = escaped;
+    return found;
+}
+
+int16_t cmd_msg_int(const cmd_msg_t *msg, int idx) {
+    int val = 0;
+    if(idx >= msg->argc || !parse_int(msg->args[idx].str, msg->args[idx].len, &val))
+        return INT16_MAX;
+    return (int16_t)val;
+}
+
+bool cmd_msg_bool(const cmd_msg_t *msg, int idx) {
+    return cmd_msg_eq(msg, idx, "true");
+}
+
+bool cmd_msg_eq(const cmd_msg_t *msg, int idx, const char *str) {
+    if(idx >= msg->argc)
+        return false;
+    int len = (int)strlen(str);
+    return msg->args[idx].len == len && memcmp(msg->args[idx].str, str, len) == 0;
+}
+
+int cmd_msg_str(const cmd_msg_t *msg, int idx, char *buf, int cap) {
+    if(idx >= msg->argc) {
+        if(cap > 0)
+            buf[0] = '\0';
+        return 0;
+    }
+    int len = msg->args[idx].len;
+    if(cap == 0)
+        return len;
+    
+    int to_copy = len > cap - 1 ? cap - 1 : len;
+    memcpy(buf, msg->args[idx].str, to_copy);
+    buf[to_copy] = '\0';
+    return to_copy;
+}
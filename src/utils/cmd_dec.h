@@ -0,0 +1,83 @@
+/*===--------------------------------------------------------------------------------------------===
+ * cmd_dec.h
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#ifndef _CMD_DEC_H_
+#define _CMD_DEC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CMD_MAX_ARGS (16)
+
+typedef struct {
+    int             start;
+    int             len;
+} cmd_span_t;
+
+// Input lives in a fixed buffer allocated at init. If it fills up without a complete command, its
+// contents are dropped along with everything up to the next `;` or newline, and counted as a
+// framing error.
+#define CMD_DEC_CAP         (4096)
+#define CMD_DEC_MIN_CAP     (64)
+
+// Decoding picks up where it stopped when a command arrives in pieces. All positions are offsets
+// into `data`, so they survive it being compacted.
+typedef struct {
+    char            *data;
+    int             cap;
+    int             size;
+    bool            resync;     // Dropping input until the next command boundary
+    unsigned        framing_errors;
+    
+    int             cmd_pos;    // Start of the command being decoded
+    int             scan_pos;   // Next byte to decode
+    int             write_pos;  // Where the next byte of the current argument goes once unescaped
+    int             arg_start;
+    bool            in_cmd;
+    bool            escaped;
+    int             argc;
+    cmd_span_t      spans[CMD_MAX_ARGS + 1];
+} cmd_dec_t;
+
+// Arguments point straight into the decoder's input buffer and are not NUL-terminated. They stay
+// valid until the next call to cmd_dec_process_input().
+typedef struct {
+    const char      *str;
+    int             len;
+} cmd_arg_t;
+
+typedef struct {
+    int16_t         id;
+    int             argc;
+    cmd_arg_t       args[CMD_MAX_ARGS];
+} cmd_msg_t;
+
+void cmd_dec_init(cmd_dec_t *dec);
+void cmd_dec_init_cap(cmd_dec_t *dec, int cap);
+void cmd_dec_fini(cmd_dec_t *dec);
+void cmd_dec_reset(cmd_dec_t *dec);
+unsigned cmd_dec_get_framing_errors(const cmd_dec_t *dec);
+
+int cmd_dec_process_input(cmd_dec_t *dec, const char *buf, int len);
+bool cmd_dec_next_cmd(cmd_dec_t *dec, cmd_msg_t *msg);
+
+int16_t cmd_msg_int(const cmd_msg_t *msg, int idx);
+bool cmd_msg_bool(const cmd_msg_t *msg, int idx);
+bool cmd_msg_eq(const cmd_msg_t *msg, int idx, const char *str);
+int cmd_msg_str(const cmd_msg_t *msg, int idx, char *buf, int cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ifndef _CMD_DEC_H_ */
@@ -0,0 +1,219 @@
+/*===--------------------------------------------------------------------------------------------===
+ * cmd_enc.c
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent. All rights reserved
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#include "cmd_enc.h"
+#include "cmd_proto.h"
+#include "scan.h"
+#include <assert.h>
+#include <string.h>
+
+#if CMD_DEBUG
+#include <acfutils/log.h>
+#endif
+
+static const scan_set_t special_chars = {{CMD_FIELD_SEP, CMD_SEP, CMD_ESCAPE, CMD_FIELD_SEP}, 3};
+
+void cmd_enc_init(cmd_enc_t *enc) {
+    str_buf_init(&enc->buf);
+    enc->sending = false;
+    enc->read_pos = 0;
+}
+
+void cmd_enc_fini(cmd_enc_t *enc) {
+    str_buf_fini(&enc->buf);
+    enc->sending = false;
+    enc->read_pos = 0;
+}
+
+static void clear_output(cmd_enc_t *enc) {
+    if(str_buf_get_size(&enc->buf) > 0)
+        str_buf_clear(&enc->buf);
+    enc->read_pos = 0;
+}
+
+// Forgets all pending output, keeping the buffer for the next connection.
+void cmd_enc_reset(cmd_enc_t *enc) {
+    clear_output(enc);
+    enc->sending = false;
+}
+
+// Consumed output is only dropped once it makes up half of the buffer, so a port that keeps taking
+// partial writes doesn't cost a memmove per write.
+static void compact_output(cmd_enc_t *enc) {
+    if(enc->read_pos == 0 || enc->read_pos * 2 < str_buf_get_size(&enc->buf))
+        return;
+    str_buf_pop_front(&enc->buf, enc->read_pos);
+    enc->read_pos = 0;
+}
+
+int cmd_enc_get_output(cmd_enc_t *enc, char *out, int cap) {
+    int available = str_buf_get_size(&enc->buf) - enc->read_pos;
+    
+    if(cap == 0 && out == NULL)
+        return available;
+    
+    const char *data = str_buf_get(&enc->buf) + enc->read_pos;
+    int to_copy = available > cap - 1 ? cap - 1 : available;
+    
+    memcpy(out, data, to_copy);
+    out[to_copy] = '\0';
+    clear_output(enc);
+    
+#if CMD_DEBUG
+    logMsg("out msg: %s", out);
+#endif
+    return to_copy;
+}
+
+// Gives direct access to every committed command that hasn't been consumed yet, so callers can send
+// a whole batch without copying or truncating it.
+const char *cmd_enc_peek_output(cmd_enc_t *enc, int *len) {
+    *len = str_buf_get_size(&enc->buf) - enc->read_pos;
+    if(*len == 0)
+        return NULL;
+    return str_buf_get(&enc->buf) + enc->read_pos;
+}
+
+// Only moves the read cursor. The bytes themselves go when the buffer is emptied or compacted.
+void cmd_enc_consume_output(cmd_enc_t *enc, int num) {
+    if(num <= 0)
+        return;
+    int available = str_buf_get_size(&enc->buf) - enc->read_pos;
+    enc->read_pos += num > available ? available : num;
+    if(enc->read_pos == str_buf_get_size(&enc->buf))
+        clear_output(enc);
+}
+
+// Drops everything past the first `len` bytes of unconsumed output, including the command being
+// built if there is one.
+void cmd_enc_truncate_output(cmd_enc_t *enc, int len) {
+    int available = str_buf_get_size(&enc->buf) - enc->read_pos;
+    enc->sending = false;
+    if(len >= available)
+        return;
+    if(len <= 0)
+        clear_output(enc);
+    else
+        str_buf_pop_back(&enc->buf, available - len);
+}
+
+int cmd_fmt_int(char *out, int16_t val) {
+    char digits[6];
+    int count = 0;
+    int len = 0;
+    int v = val;
+    
+    if(v < 0) {
+        out[len++] = '-';
+        v = -v;
+    }
+    do {
+        digits[count++] = (char)('0' + v % 10);
+        v /= 10;
+    } while(v > 0);
+    while(count > 0)
+        out[len++] = digits[--count];
+    return len;
+}
+
+void cmd_enc_send_cmd_start(cmd_enc_t *enc, int16_t cmd) {
+    if(enc->sending)
+        cmd_enc_send_cmd_commit(enc);
+    compact_output(enc);
+    char buf[8];
+    str_buf_push_back(&enc->buf, buf, cmd_fmt_int(buf, cmd));
+    enc->sending = true;
+}
+
+void cmd_enc_send_arg_int(cmd_enc_t *enc, int16_t arg) {
+    if(!enc->sending)
+        return;
+    char buf[8];
+    buf[0] = CMD_FIELD_SEP;
+    str_buf_push_back(&enc->buf, buf, 1 + cmd_fmt_int(buf + 1, arg));
+}
+
+void cmd_enc_send_arg_bool(cmd_enc_t *enc, bool arg) {
+    if(!enc->sending)
+        return;
+    if(arg)
+        str_buf_push_back(&enc->buf, ",true", 5);
+    else
+        str_buf_push_back(&enc->buf, ",false", 6);
+}
+
+void cmd_enc_send_arg_cstr(cmd_enc_t *enc, const char *str) {
+    if(!enc->sending)
+        return;
+    static const char escape = CMD_ESCAPE;
+    static const char field_sep = CMD_FIELD_SEP;
+    str_buf_push_back(&enc->buf, &field_sep, 1);
+    
+    while(*str) {
+        int len = (int)(scan_find(str, str + strlen(str), &special_chars) - str);
+        str_buf_push_back(&enc->buf, str, len);
+        str += len;
+        if(*str == '\0')
+            break;
+        str_buf_push_back(&enc->buf, &escape, 1);
+        str_buf_push_back(&enc->buf, str, 1);
+        str += 1;
+    }
+}
+
+void cmd_enc_send_cmd_commit(cmd_enc_t *enc) {
+    if(!enc->sending)
+        return;
+    str_buf_push_back(&enc->buf, ";\r\n", 3);
+    enc->sending = false;
+}
+
+// The whole command is put together on the stack and appended in one go. `args` holds every
+// argument except the list, which comes from `list`.
+static void send_tpl_line(cmd_enc_t *enc, const cmd_tpl_t *tpl, const int16_t *args,
+                          const int16_t *list, int list_len) {
+    char line[8 + CMD_TPL_MAX_ARGS * 7 + CMD_TPL_MAX_LIST * 7 + 3];
+    int argc = tpl->argc > CMD_TPL_MAX_ARGS ? CMD_TPL_MAX_ARGS : tpl->argc;
+    
+    // The prefix ends with a field separator, which a command without arguments doesn't need.
+    int len = argc > 0 ? tpl->prefix_len : tpl->prefix_len - 1;
+    memcpy(line, tpl->prefix, tpl->prefix_len);
+    for(int i = 0; i < argc; ++i) {
+        if(i > 0)
+            line[len++] = CMD_FIELD_SEP;
+        if(i != tpl->list_idx) {
+            len += cmd_fmt_int(line + len, *args++);
+            continue;
+        }
+        for(int j = 0; j < list_len; ++j) {
+            if(j > 0)
+                line[len++] = CMD_LIST_SEP;
+            len += cmd_fmt_int(line + len, list[j]);
+        }
+    }
+    memcpy(line + len, ";\r\n", 3);
+    str_buf_push_back(&enc->buf, line, len + 3);
+}
+
+void cmd_enc_send_tpl(cmd_enc_t *enc, const cmd_tpl_t *tpl, const int16_t *args,
+                      const int16_t *list, int list_len) {
+    assert(tpl->prefix_len >= 2 && tpl->prefix_len <= 4 && "template not declared with CMD_TPL()");
+    if(enc->sending)
+        cmd_enc_send_cmd_commit(enc);
+    compact_output(enc);
+    
+    // Cutting the list short would send a valid command with the wrong pins, so a long one goes out
+    // in pieces instead.
+    int off = 0;
+    do {
+        int count = list_len - off > CMD_TPL_MAX_LIST ? CMD_TPL_MAX_LIST : list_len - off;
+        send_tpl_line(enc, tpl, args, list + off, count);
+        off += count;
+    } while(off < list_len && tpl->list_idx != CMD_TPL_NO_LIST);
+}
@@ -0,0 +1,80 @@
+/*===--------------------------------------------------------------------------------------------===
+ * cmd_enc.h
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#ifndef _CMD_ENC_H_
+#define _CMD_ENC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "str_buf.h"
+#include "cmd_proto.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Builds outgoing commands. An encoder shares nothing with a decoder, so one thread can encode while
+// another decodes.
+typedef struct {
+    bool            sending;
+    str_buf_t       buf;
+    int             read_pos;   // Start of the output that hasn't been consumed yet
+} cmd_enc_t;
+
+void cmd_enc_init(cmd_enc_t *enc);
+void cmd_enc_fini(cmd_enc_t *enc);
+void cmd_enc_reset(cmd_enc_t *enc);
+
+int cmd_enc_get_output(cmd_enc_t *enc, char *out, int cap);
+const char *cmd_enc_peek_output(cmd_enc_t *enc, int *len);
+void cmd_enc_consume_output(cmd_enc_t *enc, int num);
+void cmd_enc_truncate_output(cmd_enc_t *enc, int len);
+void cmd_enc_send_cmd_start(cmd_enc_t *enc, int16_t cmd);
+void cmd_enc_send_arg_int(cmd_enc_t *enc, int16_t arg);
+void cmd_enc_send_arg_bool(cmd_enc_t *enc, bool arg);
+void cmd_enc_send_arg_cstr(cmd_enc_t *enc, const char *str);
+void cmd_enc_send_cmd_commit(cmd_enc_t *enc);
+
+// Templates describe the shape of a hot command, so it can be formatted on the stack and appended
+// in one go. The command id and its separator are formatted at compile time; only the arguments are
+// written on each send. An argument can be a list of values joined with '|', like the pins of
+// kSetShiftRegisterPins; a list longer than CMD_TPL_MAX_LIST is sent as several commands with the
+// same arguments. Templates are constant: declare them with CMD_TPL(), with an id from 0 to 999.
+#define CMD_TPL_MAX_ARGS    (4)
+#define CMD_TPL_MAX_LIST    (32)
+#define CMD_TPL_NO_LIST     (-1)
+
+typedef struct {
+    char            prefix[4];  // The command id and the field separator, e.g. "17,"
+    int             prefix_len;
+    int             argc;       // At most CMD_TPL_MAX_ARGS
+    int             list_idx;   // Which argument is a list, or CMD_TPL_NO_LIST
+} cmd_tpl_t;
+
+#define CMD_TPL_DIGITS(cmd)     ((cmd) < 10 ? 1 : (cmd) < 100 ? 2 : 3)
+#define CMD_TPL_POW10(n)        ((n) == 0 ? 1 : (n) == 1 ? 10 : 100)
+#define CMD_TPL_CHAR(cmd, i)                                                                       \
+    ((i) < CMD_TPL_DIGITS(cmd) ? (char)('0' + (cmd) / CMD_TPL_POW10(CMD_TPL_DIGITS(cmd) - 1 - (i)) % 10) \
+     : (i) == CMD_TPL_DIGITS(cmd) ? CMD_FIELD_SEP : '\0')
+
+#define CMD_TPL(cmd, argc, list_idx) {                                                             \
+    {CMD_TPL_CHAR(cmd, 0), CMD_TPL_CHAR(cmd, 1), CMD_TPL_CHAR(cmd, 2), CMD_TPL_CHAR(cmd, 3)},     \
+    CMD_TPL_DIGITS(cmd) + 1, (argc), (list_idx)}
+
+void cmd_enc_send_tpl(cmd_enc_t *enc, const cmd_tpl_t *tpl, const int16_t *args,
+                      const int16_t *list, int list_len);
+
+// Writes `val` in decimal without going through printf. Returns the length written (at most 6).
+int cmd_fmt_int(char *out, int16_t val);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ifndef _CMD_ENC_H_ */
@@ -0,0 +1,23 @@
+/*===--------------------------------------------------------------------------------------------===
+ * cmd_proto.h
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#ifndef _CMD_PROTO_H_
+#define _CMD_PROTO_H_
+
+#ifndef CMD_DEBUG
+#define CMD_DEBUG 0
+#endif
+
+// CmdMessenger separators. Any of them can appear in an argument when preceded by the escape.
+#define CMD_FIELD_SEP   ','
+#define CMD_SEP         ';'
+#define CMD_ESCAPE      '/'
+#define CMD_LIST_SEP    '|'
+
+#endif /* ifndef _CMD_PROTO_H_ */
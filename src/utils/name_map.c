@@ -0,0 +1,103 @@
+/*===--------------------------------------------------------------------------------------------===
+ * name_map.c
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent. All rights reserved
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#include "name_map.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NAME_MAP_MIN_CAPACITY   (16)
+
+void name_map_init(name_map_t *map) {
+    map->entries = NULL;
+    map->capacity = 0;
+    map->count = 0;
+}
+
+void name_map_fini(name_map_t *map) {
+    free(map->entries);
+    name_map_init(map);
+}
+
+void name_map_clear(name_map_t *map) {
+    if(map->entries != NULL)
+        memset(map->entries, 0, map->capacity * sizeof(*map->entries));
+    map->count = 0;
+}
+
+// FNV-1a. Input names are short, so anything fancier wouldn't pay for itself.
+uint32_t name_map_hash(const char *str, int len) {
+    uint32_t hash = 2166136261u;
+    for(int i = 0; i < len; ++i) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool entry_matches(const name_map_entry_t *entry, uint32_t hash, int tag,
+                          const char *str, int len) {
+    return entry->hash == hash
+        && entry->tag == tag
+        && strncmp(entry->key, str, len) == 0
+        && entry->key[len] == '\0';
+}
+
+static void put_entry(name_map_entry_t *entries, int capacity, const name_map_entry_t *entry) {
+    uint32_t mask = (uint32_t)capacity - 1;
+    uint32_t idx = entry->hash & mask;
+    while(entries[idx].key != NULL)
+        idx = (idx + 1) & mask;
+    entries[idx] = *entry;
+}
+
+// Keeps the load factor under 1/2, so probe sequences stay short.
+static void grow(name_map_t *map) {
+    int capacity = map->capacity == 0 ? NAME_MAP_MIN_CAPACITY : map->capacity * 2;
+    name_map_entry_t *entries = calloc(capacity, sizeof(*entries));
+    assert(entries && "failure to allocate entries");
+    
+    for(int i = 0; i < map->capacity; ++i) {
+        if(map->entries[i].key != NULL)
+            put_entry(entries, capacity, &map->entries[i]);
+    }
+    free(map->entries);
+    map->entries = entries;
+    map->capacity = capacity;
+}
+
+void name_map_insert(name_map_t *map, int tag, const char *key, int value) {
+    int len = (int)strlen(key);
+    if(name_map_find(map, tag, key, len) >= 0)
+        return;
+    if((map->count + 1) * 2 > map->capacity)
+        grow(map);
+    
+    name_map_entry_t entry = {
+        .hash = name_map_hash(key, len),
+        .tag = tag,
+        .key = key,
+        .value = value,
+    };
+    put_entry(map->entries, map->capacity, &entry);
+    map->count += 1;
+}
+
+int name_map_find(const name_map_t *map, int tag, const char *str, int len) {
+    if(map->count == 0)
+        return -1;
+    
+    uint32_t hash = name_map_hash(str, len);
+    uint32_t mask = (uint32_t)map->capacity - 1;
+    for(uint32_t idx = hash & mask; map->entries[idx].key != NULL; idx = (idx + 1) & mask) {
+        if(entry_matches(&map->entries[idx], hash, tag, str, len))
+            return map->entries[idx].value;
+    }
+    return -1;
+}
@@ -0,0 +1,52 @@
+/*===--------------------------------------------------------------------------------------------===
+ * name_map.h
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#ifndef _NAME_MAP_H_
+#define _NAME_MAP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Open-addressing (linear probing) table from a name and a tag to a non-negative integer, usually an
+// index into an array. Keys aren't copied: they must outlive their entry. Nothing is ever removed;
+// when keys change or move, clear the map and insert everything again.
+typedef struct {
+    uint32_t        hash;
+    int             tag;
+    const char      *key;
+    int             value;
+} name_map_entry_t;
+
+typedef struct {
+    name_map_entry_t    *entries;
+    int                 capacity;   // Always a power of two, or 0
+    int                 count;
+} name_map_t;
+
+void name_map_init(name_map_t *map);
+void name_map_fini(name_map_t *map);
+void name_map_clear(name_map_t *map);
+
+// If `key` is already in the map with the same tag, the first value inserted is kept.
+void name_map_insert(name_map_t *map, int tag, const char *key, int value);
+
+// `str` doesn't have to be NUL-terminated. Returns -1 if there is no match.
+int name_map_find(const name_map_t *map, int tag, const char *str, int len);
+
+uint32_t name_map_hash(const char *str, int len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ifndef _NAME_MAP_H_ */
@@ -0,0 +1,96 @@
+/*===--------------------------------------------------------------------------------------------===
+ * ring.c
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent. All rights reserved
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#include "ring.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+void ring_init(ring_t *ring, uint32_t cap) {
+    uint32_t size = 16;
+    while(size < cap)
+        size <<= 1;
+    ring->data = malloc(size);
+    assert(ring->data && "failure to allocate data");
+    ring->mask = size - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+}
+
+void ring_fini(ring_t *ring) {
+    free(ring->data);
+    ring->data = NULL;
+    ring->mask = 0;
+}
+
+static inline uint32_t ring_cap(const ring_t *ring) {
+    return ring->mask + 1;
+}
+
+int ring_get_free(ring_t *ring) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return (int)(ring_cap(ring) - (head - tail));
+}
+
+int ring_get_size(ring_t *ring) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    return (int)(head - tail);
+}
+
+int ring_write(ring_t *ring, const char *data, int len) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t avail = ring_cap(ring) - (head - tail);
+    uint32_t num = (uint32_t)len < avail ? (uint32_t)len : avail;
+    if(num == 0)
+        return 0;
+    
+    uint32_t start = head & ring->mask;
+    uint32_t first = ring_cap(ring) - start;
+    if(first > num)
+        first = num;
+    memcpy(ring->data + start, data, first);
+    memcpy(ring->data, data + first, num - first);
+    
+    atomic_store_explicit(&ring->head, head + num, memory_order_release);
+    return (int)num;
+}
+
+bool ring_write_all(ring_t *ring, const char *data, int len) {
+    if(ring_get_free(ring) < len)
+        return false;
+    ring_write(ring, data, len);
+    return true;
+}
+
+int ring_read(ring_t *ring, char *out, int cap) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t avail = head - tail;
+    uint32_t num = (uint32_t)cap < avail ? (uint32_t)cap : avail;
+    if(num == 0)
+        return 0;
+    
+    uint32_t start = tail & ring->mask;
+    uint32_t first = ring_cap(ring) - start;
+    if(first > num)
+        first = num;
+    memcpy(out, ring->data + start, first);
+    memcpy(out + first, ring->data, num - first);
+    
+    atomic_store_explicit(&ring->tail, tail + num, memory_order_release);
+    return (int)num;
+}
+
+void ring_clear(ring_t *ring) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    atomic_store_explicit(&ring->tail, head, memory_order_release);
+}
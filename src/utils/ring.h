@@ -0,0 +1,47 @@
+/*===--------------------------------------------------------------------------------------------===
+ * ring.h
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#ifndef _RING_H_
+#define _RING_H_
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bounded single-producer, single-consumer byte ring. One thread may write, one (other) thread may
+// read, without any locking. Capacity is rounded up to a power of two.
+typedef struct {
+    char                *data;
+    uint32_t            mask;
+    _Atomic uint32_t    head;       // Only written by the producer
+    _Atomic uint32_t    tail;       // Only written by the consumer
+} ring_t;
+
+void ring_init(ring_t *ring, uint32_t cap);
+void ring_fini(ring_t *ring);
+
+// Producer side. `ring_write` copies as much as fits, `ring_write_all` copies all or nothing.
+int ring_write(ring_t *ring, const char *data, int len);
+bool ring_write_all(ring_t *ring, const char *data, int len);
+int ring_get_free(ring_t *ring);
+
+// Consumer side.
+int ring_read(ring_t *ring, char *out, int cap);
+int ring_get_size(ring_t *ring);
+void ring_clear(ring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ifndef _RING_H_ */
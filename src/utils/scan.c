@@ -0,0 +1,143 @@
+/*===--------------------------------------------------------------------------------------------===
+ * scan.c
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent. All rights reserved
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#include "scan.h"
+#include <assert.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SCAN_X86    (1)
+#include <immintrin.h>
+#else
+#define SCAN_X86    (0)
+#endif
+
+static scan_impl_t forced_impl = SCAN_AUTO;
+
+void scan_set_init(scan_set_t *set, const char *delims) {
+    int count = (int)strlen(delims);
+    assert(count > 0 && count <= SCAN_MAX_DELIMS && "invalid delimiter set");
+    for(int i = 0; i < SCAN_MAX_DELIMS; ++i)
+        set->delims[i] = delims[i < count ? i : 0];
+    set->count = count;
+}
+
+static const char *scan_scalar(const char *str, const char *end, const scan_set_t *set) {
+    if(set->count == 1) {
+        const char *found = memchr(str, set->delims[0], end - str);
+        return found != NULL ? found : end;
+    }
+    for(; str < end; ++str) {
+        char c = *str;
+        if(c == set->delims[0] || c == set->delims[1] || c == set->delims[2] || c == set->delims[3])
+            return str;
+    }
+    return end;
+}
+
+#if SCAN_X86
+
+__attribute__((target("sse2")))
+static const char *scan_sse2(const char *str, const char *end, const scan_set_t *set) {
+    const __m128i d0 = _mm_set1_epi8(set->delims[0]);
+    const __m128i d1 = _mm_set1_epi8(set->delims[1]);
+    const __m128i d2 = _mm_set1_epi8(set->delims[2]);
+    const __m128i d3 = _mm_set1_epi8(set->delims[3]);
+    
+    while(end - str >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)str);
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, d0), _mm_cmpeq_epi8(v, d1)),
+                                 _mm_or_si128(_mm_cmpeq_epi8(v, d2), _mm_cmpeq_epi8(v, d3)));
+        unsigned mask = (unsigned)_mm_movemask_epi8(m);
+        if(mask != 0)
+            return str + __builtin_ctz(mask);
+        str += 16;
+    }
+    return scan_scalar(str, end, set);
+}
+
+__attribute__((target("avx2")))
+static const char *scan_avx2(const char *str, const char *end, const scan_set_t *set) {
+    const __m256i d0 = _mm256_set1_epi8(set->delims[0]);
+    const __m256i d1 = _mm256_set1_epi8(set->delims[1]);
+    const __m256i d2 = _mm256_set1_epi8(set->delims[2]);
+    const __m256i d3 = _mm256_set1_epi8(set->delims[3]);
+    
+    while(end - str >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)str);
+        __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, d0), _mm256_cmpeq_epi8(v, d1)),
+                                    _mm256_or_si256(_mm256_cmpeq_epi8(v, d2), _mm256_cmpeq_epi8(v, d3)));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(m);
+        if(mask != 0)
+            return str + __builtin_ctz(mask);
+        str += 32;
+    }
+    // Finish the tail 16 bytes at a time before falling back to bytes.
+    return scan_sse2(str, end, set);
+}
+
+static bool has_sse2(void) {
+    return __builtin_cpu_supports("sse2");
+}
+
+static bool has_avx2(void) {
+    return __builtin_cpu_supports("avx2");
+}
+
+#else
+
+static bool has_sse2(void) {
+    return false;
+}
+
+static bool has_avx2(void) {
+    return false;
+}
+
+#endif
+
+scan_impl_t scan_get_impl(void) {
+    if(forced_impl != SCAN_AUTO)
+        return forced_impl;
+    if(has_avx2())
+        return SCAN_AVX2;
+    if(has_sse2())
+        return SCAN_SSE2;
+    return SCAN_SCALAR;
+}
+
+bool scan_set_impl(scan_impl_t impl) {
+    if(impl == SCAN_SSE2 && !has_sse2())
+        return false;
+    if(impl == SCAN_AVX2 && !has_avx2())
+        return false;
+    forced_impl = impl;
+    return true;
+}
+
+const char *scan_impl_str(scan_impl_t impl) {
+    switch(impl) {
+    case SCAN_AUTO: return "auto";
+    case SCAN_SCALAR: return "scalar";
+    case SCAN_SSE2: return "sse2";
+    case SCAN_AVX2: return "avx2";
+    }
+    return "unknown";
+}
+
+const char *scan_find(const char *str, const char *end, const scan_set_t *set) {
+#if SCAN_X86
+    switch(scan_get_impl()) {
+    case SCAN_AVX2: return scan_avx2(str, end, set);
+    case SCAN_SSE2: return scan_sse2(str, end, set);
+    default: break;
+    }
+#endif
+    return scan_scalar(str, end, set);
+}
@@ -0,0 +1,50 @@
+/*===--------------------------------------------------------------------------------------------===
+ * scan.h
+ *
+ * Created by Amy Parent <amy@amyparent.com>
+ * Copyright (c) 2025 Amy Parent
+ *
+ * Licensed under the MIT License
+ *===--------------------------------------------------------------------------------------------===
+*/
+#ifndef _SCAN_H_
+#define _SCAN_H_
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCAN_MAX_DELIMS (4)
+
+// A small set of delimiter bytes to look for. Unused slots repeat the first delimiter so the
+// vector paths can always compare against all of them.
+typedef struct {
+    char    delims[SCAN_MAX_DELIMS];
+    int     count;
+} scan_set_t;
+
+typedef enum {
+    SCAN_AUTO,
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2,
+} scan_impl_t;
+
+void scan_set_init(scan_set_t *set, const char *delims);
+
+// Returns the first byte in [str, end) that is in `set`, or `end` if there is none. Uses AVX2 or
+// SSE2 when the CPU has them, plain loops everywhere else.
+const char *scan_find(const char *str, const char *end, const scan_set_t *set);
+
+// Forces one implementation, for benchmarks. Returns false if this CPU can't run it.
+bool scan_set_impl(scan_impl_t impl);
+scan_impl_t scan_get_impl(void);
+const char *scan_impl_str(scan_impl_t impl);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ifndef _SCAN_H_ */
@@ -81,6 +81,13 @@ void str_buf_pop_front(str_buf_t *buf, int num) {
     buf->data[buf->size] = '\0';
 }
 
+void str_buf_pop_back(str_buf_t *buf, int num) {
+    int to_remove = num > buf->size ? buf->size : num;
+    buf->size -= to_remove;
+    if(buf->cap > 0)
+        buf->data[buf->size] = '\0';
+}
+
 char *str_buf_get(str_buf_t *buf) {
     return buf->data;
 }
@@ -32,6 +32,7 @@ void str_buf_push_back(str_buf_t *buf, const char *str, int len);
 void str_buf_printf_back(str_buf_t *buf, const char *fmt, ...);
 
 void str_buf_pop_front(str_buf_t *buf, int num);
+void str_buf_pop_back(str_buf_t *buf, int num);
 
 int str_buf_get_size(const str_buf_t *buf);
 char *str_buf_get(str_buf_t *buf);